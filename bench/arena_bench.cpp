@@ -0,0 +1,93 @@
+// Compares parsing into arena-allocated AST nodes against one heap allocation per node.
+//
+// The input is a generated function with a wide block of short statements:
+//   func big(x, y) { x * 1.5 + y / 2.25 - x; ... return x; }
+// Each mode runs in a fresh process so peak RSS is measured independently.
+//
+// Usage: arena_bench [statements] [iterations]
+
+#include "session.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static std::string GenerateSource(size_t Statements) {
+    std::string Src = "func big(x, y) {\n";
+    Src.reserve(Statements * 32);
+    for (size_t i = 0; i < Statements; ++i)
+        Src += "  x * 1.5 + y / 2.25 - (x + " + std::to_string(i % 97) + ") * y;\n";
+    Src += "  return x;\n}\n";
+    return Src;
+}
+
+static long PeakRSSKiB() {
+    rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+    return Usage.ru_maxrss;
+}
+
+static int RunMode(bool UseArena, size_t Statements, int Iterations) {
+    std::string Src = GenerateSource(Statements);
+    long RSSBefore = PeakRSSKiB();
+
+    double BestParse = 1e300, BestFree = 1e300;
+    size_t ArenaBytes = 0;
+    for (int i = 0; i < Iterations; ++i) {
+        auto Session = std::make_unique<CompilerSession>(UseArena);
+        Session->setSource(Src);
+
+        auto Start = std::chrono::steady_clock::now();
+        if (!Session->parse()) {
+            std::cerr << "parse failed\n";
+            return 1;
+        }
+        auto Parsed = std::chrono::steady_clock::now();
+        ArenaBytes = Session->getArena().getBytesAllocated();
+        Session.reset();
+        auto Freed = std::chrono::steady_clock::now();
+
+        BestParse = std::min(BestParse, std::chrono::duration<double>(Parsed - Start).count());
+        BestFree = std::min(BestFree, std::chrono::duration<double>(Freed - Parsed).count());
+    }
+
+    std::cout << (UseArena ? "arena" : "heap ") << "  parse " << BestParse * 1e3 << " ms"
+              << "  free " << BestFree * 1e3 << " ms"
+              << "  peak RSS " << PeakRSSKiB() << " KiB (+" << PeakRSSKiB() - RSSBefore
+              << " KiB over source)"
+              << "  arena bytes " << ArenaBytes << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--mode") == 0 && argc == 5)
+        return RunMode(std::strcmp(argv[2], "arena") == 0, std::strtoull(argv[3], nullptr, 10),
+                       std::atoi(argv[4]));
+
+    std::string Statements = argc > 1 ? argv[1] : "200000";
+    std::string Iterations = argc > 2 ? argv[2] : "5";
+    std::cout << "statements: " << Statements << "\n";
+
+    for (const char* Mode : {"heap", "arena"}) {
+        std::cout.flush();
+        pid_t Pid = fork();
+        if (Pid == 0) {
+            execl("/proc/self/exe", argv[0], "--mode", Mode, Statements.c_str(),
+                  Iterations.c_str(), static_cast<char*>(nullptr));
+            std::perror("execl");
+            _exit(127);
+        }
+        int Status = 0;
+        waitpid(Pid, &Status, 0);
+        if (!WIFEXITED(Status) || WEXITSTATUS(Status) != 0)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Compares a JIT-compiled batch kernel against calling the scalar function once per row.
+//
+//   func calculate(x, y) { return (x * 1.5 + y) * (x - y) / (y + 2.0); }
+//
+// Usage: batch_bench [rows] [iterations]
+
+#include "ast.hpp"
+#include "jit.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+static std::unique_ptr<FunctionAST> MakeCalculate() {
+    static SymbolTable Symbols;
+    SymbolID XName = Symbols.intern("x"), YName = Symbols.intern("y");
+    auto X = [&] { return MakeAST<VariableExprAST>(XName); };
+    auto Y = [&] { return MakeAST<VariableExprAST>(YName); };
+    auto Num = [](double V) { return MakeAST<NumberExprAST>(V); };
+    auto Bin = [](char Op, ExprPtr L, ExprPtr R) {
+        return MakeAST<BinaryExprAST>(Op, std::move(L), std::move(R));
+    };
+
+    auto Expr = Bin('/',
+                    Bin('*', Bin('+', Bin('*', X(), Num(1.5)), Y()), Bin('-', X(), Y())),
+                    Bin('+', Y(), Num(2.0)));
+
+    std::vector<ExprPtr> Body;
+    Body.push_back(MakeAST<ReturnExprAST>(std::move(Expr)));
+    return std::make_unique<FunctionAST>(
+        "calculate", std::vector<SymbolID>{XName, YName},
+        MakeAST<BlockExprAST>(std::move(Body)), Symbols);
+}
+
+template <typename Fn>
+static double BestOf(int Iterations, Fn&& Body) {
+    double Best = 1e300;
+    for (int i = 0; i < Iterations; ++i) {
+        auto Start = std::chrono::steady_clock::now();
+        Body();
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+        Best = std::min(Best, Elapsed.count());
+    }
+    return Best;
+}
+
+int main(int argc, char** argv) {
+    size_t Rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 22);
+    int Iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    auto JIT = MyLangJIT::Create(3);
+    if (!JIT)
+        return 1;
+
+    auto Func = MakeCalculate();
+    auto* Batch = reinterpret_cast<void (*)(const double*, const double*, double*, size_t)>(
+        JIT->compileBatch(Func.get()));
+    auto* Scalar = JIT->getFunction<double(double, double)>("calculate");
+    if (!Batch || !Scalar)
+        return 1;
+
+    std::mt19937_64 Rng(42);
+    std::uniform_real_distribution<double> Dist(-100.0, 100.0);
+    std::vector<double> X(Rows), Y(Rows), OutScalar(Rows), OutBatch(Rows);
+    for (size_t i = 0; i < Rows; ++i) {
+        X[i] = Dist(Rng);
+        Y[i] = Dist(Rng);
+    }
+
+    // Call through a volatile pointer so the host compiler cannot see through the call
+    double (*volatile ScalarFn)(double, double) = Scalar;
+    double ScalarTime = BestOf(Iterations, [&] {
+        for (size_t i = 0; i < Rows; ++i)
+            OutScalar[i] = ScalarFn(X[i], Y[i]);
+    });
+    double BatchTime = BestOf(Iterations, [&] { Batch(X.data(), Y.data(), OutBatch.data(), Rows); });
+
+    for (size_t i = 0; i < Rows; ++i) {
+        if (OutScalar[i] != OutBatch[i] && !(std::isnan(OutScalar[i]) && std::isnan(OutBatch[i]))) {
+            std::cerr << "Mismatch at row " << i << ": " << OutScalar[i] << " vs " << OutBatch[i] << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "rows:            " << Rows << "\n"
+              << "scalar per row:  " << ScalarTime * 1e9 / Rows << " ns/row\n"
+              << "batch kernel:    " << BatchTime * 1e9 / Rows << " ns/row\n"
+              << "speedup:         " << ScalarTime / BatchTime << "x\n";
+    return 0;
+}
@@ -0,0 +1,561 @@
+// Compiler benchmark suite (Google Benchmark).
+//
+// Each phase is measured over synthetic sources from source_gen.hpp:
+//   deep  - one expression nested N levels deep
+//   wide  - one function with N assignment statements
+//   many  - N functions with branches, loops and calls
+// Counters report throughput per phase: bytes and tokens/s for the lexer,
+// AST nodes/s for the parser, IR instructions/s for codegen and the optimizer,
+// compiles/s for the JIT, and evaluated rows/s for generated code. The
+// BM_*Tree/BM_*Flat pairs run the same pass over the ExprAST pointer tree and
+// over its FlatFunction form, with bytes_per_node for each layout.
+//
+// Usage: my_lang_bench [--benchmark_filter=REGEX] [--benchmark_format=json] ...
+//        my_lang_bench --generate deep|wide|many N   (print a source, e.g. for --time-report)
+
+#include "codegen.hpp"
+#include "flat_ast.hpp"
+#include "jit.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "session.hpp"
+#include "source_gen.hpp"
+#include "stats.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+enum SourceKind { Deep, Wide, Many };
+
+static std::string Generate(SourceKind Kind, size_t N) {
+    switch (Kind) {
+        case Deep: return GenerateDeepExpression(N);
+        case Wide: return GenerateWideBlock(N);
+        case Many: return GenerateManyFunctions(N);
+    }
+    return "";
+}
+
+using Rate = benchmark::Counter;
+constexpr auto PerIterationRate = benchmark::Counter::kIsIterationInvariantRate;
+
+static void BM_Lex(benchmark::State& State, SourceKind Kind) {
+    std::string Source = Generate(Kind, State.range(0));
+    size_t Tokens = 0;
+    for (auto _ : State) {
+        BufferLexer Lexer(Source);
+        Tokens = 0;
+        for (TokenInfo Tok = Lexer.next(); Tok.Kind != tok_eof; Tok = Lexer.next()) {
+            benchmark::DoNotOptimize(Tok);
+            ++Tokens;
+        }
+    }
+    State.SetBytesProcessed(State.iterations() * Source.size());
+    State.counters["tokens"] = Rate(Tokens, PerIterationRate);
+}
+
+static void BM_Parse(benchmark::State& State, SourceKind Kind) {
+    std::string Source = Generate(Kind, State.range(0));
+    size_t Nodes = 0;
+    for (auto _ : State) {
+        // Destroying the AST is part of the cost, as in a real compile
+        ASTArena Arena;
+        Parser P(Source, Arena);
+        P.getNextToken();
+        auto Functions = P.ParseTranslationUnit();
+        if (P.hadError()) {
+            State.SkipWithError("parse failed");
+            return;
+        }
+        benchmark::DoNotOptimize(Functions.data());
+        Nodes = Arena.getNodeCount();
+    }
+    State.SetBytesProcessed(State.iterations() * Source.size());
+    State.counters["nodes"] = Rate(Nodes, PerIterationRate);
+}
+
+static void BM_Codegen(benchmark::State& State, SourceKind Kind) {
+    CompilerSession Session;
+    std::string Source = Generate(Kind, State.range(0));
+    Session.setSource(Source);
+    if (!Session.parse()) {
+        State.SkipWithError("parse failed");
+        return;
+    }
+
+    uint64_t Instructions = 0;
+    for (auto _ : State) {
+        llvm::LLVMContext Context;
+        llvm::Module Module("bench", Context);
+        for (const auto& Func : Session.getFunctions()) {
+            if (!GenerateLLVMFunction(Func.get(), Module)) {
+                State.SkipWithError("codegen failed");
+                return;
+            }
+        }
+        Instructions = CountInstructions(Module);
+    }
+    State.counters["instructions"] = Rate(Instructions, PerIterationRate);
+}
+
+static void BM_Optimize(benchmark::State& State, SourceKind Kind) {
+    std::string Source = Generate(Kind, State.range(0));
+    unsigned OptLevel = State.range(1);
+    uint64_t Instructions = 0;
+    for (auto _ : State) {
+        State.PauseTiming();
+        CompilerSession Session;
+        Session.setSource(Source);
+        if (!Session.parse() || !Session.codegen()) {
+            State.SkipWithError("compile failed");
+            return;
+        }
+        Instructions = CountInstructions(Session.getModule());
+        State.ResumeTiming();
+
+        Session.optimize(OptLevel, nullptr);
+    }
+    State.counters["instructions"] = Rate(Instructions, PerIterationRate);
+}
+
+// Code generation, -O2 and linking of a whole translation unit on range(1) threads
+static void BM_ParallelBuild(benchmark::State& State, SourceKind Kind) {
+    std::string Source = Generate(Kind, State.range(0));
+    unsigned Threads = State.range(1);
+    for (auto _ : State) {
+        State.PauseTiming();
+        CompilerSession Session;
+        Session.setSource(Source);
+        if (!Session.parse()) {
+            State.SkipWithError("parse failed");
+            return;
+        }
+        Session.setThreads(Threads);
+        State.ResumeTiming();
+
+        if (!Session.codegen()) {
+            State.SkipWithError("codegen failed");
+            return;
+        }
+        Session.optimize(2, nullptr);
+        benchmark::DoNotOptimize(&Session.getModule());
+    }
+    State.counters["functions"] = Rate(State.range(0), PerIterationRate);
+}
+
+// One warm JIT per optimization level, as the compile server keeps them
+static MyLangJIT* GetJIT(unsigned OptLevel) {
+    static std::unique_ptr<MyLangJIT> JITs[4];
+    if (!JITs[OptLevel])
+        JITs[OptLevel] = MyLangJIT::Create(OptLevel);
+    return JITs[OptLevel].get();
+}
+
+// Google Benchmark may call a benchmark several times, so every compile gets its own library
+static llvm::orc::JITDylib* NewLibrary(MyLangJIT* JIT) {
+    static size_t NextId = 0;
+    return JIT->createLibrary("bench" + std::to_string(NextId++));
+}
+
+// Source to lookup of a callable address, in a library of its own that is removed again
+static void BM_JITCompile(benchmark::State& State, SourceKind Kind) {
+    std::string Source = Generate(Kind, State.range(0));
+    MyLangJIT* JIT = GetJIT(State.range(1));
+    std::string Entry = Kind == Deep ? "deep" : Kind == Wide ? "wide" : "f0";
+    if (!JIT) {
+        State.SkipWithError("JIT unavailable");
+        return;
+    }
+
+    for (auto _ : State) {
+        CompilerSession Session;
+        Session.setSource(Source);
+        if (!Session.parse() || !Session.codegen()) {
+            State.SkipWithError("compile failed");
+            return;
+        }
+        llvm::orc::JITDylib* Lib = NewLibrary(JIT);
+        if (!Lib || !JIT->addModule(Session.takeModule(), Lib) || !JIT->lookup(Entry, Lib)) {
+            State.SkipWithError("JIT compile failed");
+            return;
+        }
+        JIT->removeLibrary(Lib);
+    }
+    State.counters["compiles"] = Rate(1, PerIterationRate);
+}
+
+// Generated code speed: a scalar call per row against the vectorized batch kernel
+static const char* EvalSource =
+    "func calculate(x, y) { return sqrt(x * x + y * y) * (x - y) / (y + 2.0) + max(x, y); }";
+
+// Compile EvalSource at -O3 and look up Name; Lib receives the library to remove afterwards
+static void* CompileEval(const char* Name, bool WithBatchKernel, llvm::orc::JITDylib*& Lib) {
+    MyLangJIT* JIT = GetJIT(3);
+    CompilerSession Session;
+    Session.setSource(EvalSource);
+    Lib = JIT ? NewLibrary(JIT) : nullptr;
+    if (!Lib || !Session.parse() || !Session.codegen(WithBatchKernel) ||
+        !JIT->addModule(Session.takeModule(), Lib))
+        return nullptr;
+    return JIT->lookup(Name, Lib);
+}
+
+static void FillColumns(std::vector<double>& X, std::vector<double>& Y) {
+    for (size_t i = 0; i < X.size(); ++i) {
+        X[i] = static_cast<double>(i % 1000) * 0.5;
+        Y[i] = static_cast<double>(i % 777) * 0.25;
+    }
+}
+
+static void BM_EvalScalar(benchmark::State& State) {
+    size_t Rows = State.range(0);
+    llvm::orc::JITDylib* Lib;
+    auto* Calculate = reinterpret_cast<double (*)(double, double)>(CompileEval("calculate", false, Lib));
+    if (!Calculate) {
+        State.SkipWithError("compile failed");
+        return;
+    }
+
+    std::vector<double> X(Rows), Y(Rows), Out(Rows);
+    FillColumns(X, Y);
+    for (auto _ : State) {
+        for (size_t i = 0; i < Rows; ++i)
+            Out[i] = Calculate(X[i], Y[i]);
+        benchmark::DoNotOptimize(Out.data());
+    }
+    State.SetItemsProcessed(State.iterations() * Rows);
+    GetJIT(3)->removeLibrary(Lib);
+}
+
+static void BM_EvalBatch(benchmark::State& State) {
+    size_t Rows = State.range(0);
+    llvm::orc::JITDylib* Lib;
+    auto* Batch = reinterpret_cast<void (*)(const double*, const double*, double*, size_t)>(
+        CompileEval("calculate_batch", true, Lib));
+    if (!Batch) {
+        State.SkipWithError("compile failed");
+        return;
+    }
+
+    std::vector<double> X(Rows), Y(Rows), Out(Rows);
+    FillColumns(X, Y);
+    for (auto _ : State) {
+        Batch(X.data(), Y.data(), Out.data(), Rows);
+        benchmark::DoNotOptimize(Out.data());
+    }
+    State.SetItemsProcessed(State.iterations() * Rows);
+    GetJIT(3)->removeLibrary(Lib);
+}
+
+// AST layouts: the same read-only pass over the pointer tree and the flat arrays.
+// The pass counts nodes and assignments and sums the literals, so every node is touched.
+struct ASTSummary {
+    size_t Nodes = 0;
+    size_t Assigns = 0;
+    double Literals = 0.0;
+};
+
+class TreeSummary : public CodegenVisitor {
+public:
+    ASTSummary Result;
+
+    void visit(NumberExprAST* expr) override {
+        ++Result.Nodes;
+        Result.Literals += expr->getValue();
+    }
+    void visit(VariableExprAST*) override { ++Result.Nodes; }
+    void visit(BinaryExprAST* expr) override {
+        WalkBinaryTree(
+            expr,
+            [&](ExprPtr& Operand) {
+                Operand->accept(*this);
+                return true;
+            },
+            [&](BinaryExprAST*, ExprPtr*) {
+                ++Result.Nodes;
+                return true;
+            });
+    }
+    void visit(ReturnExprAST* expr) override {
+        ++Result.Nodes;
+        expr->getExpr()->accept(*this);
+    }
+    void visit(BlockExprAST* expr) override {
+        ++Result.Nodes;
+        for (const auto& E : expr->getExpressions())
+            E->accept(*this);
+    }
+    void visit(IfExprAST* expr) override {
+        ++Result.Nodes;
+        expr->getCond()->accept(*this);
+        expr->getThen()->accept(*this);
+        if (expr->getElse())
+            expr->getElse()->accept(*this);
+    }
+    void visit(WhileExprAST* expr) override {
+        ++Result.Nodes;
+        expr->getCond()->accept(*this);
+        expr->getBody()->accept(*this);
+    }
+    void visit(AssignExprAST* expr) override {
+        ++Result.Nodes;
+        ++Result.Assigns;
+        expr->getValue()->accept(*this);
+    }
+    void visit(CallExprAST* expr) override {
+        ++Result.Nodes;
+        for (const auto& Arg : expr->getArgs())
+            Arg->accept(*this);
+    }
+    void visit(FunctionAST* func) override { func->getBody()->accept(*this); }
+};
+
+// Bytes of the tree's nodes and child vectors; arena slack and the symbol table are not counted
+class TreeBytes : public CodegenVisitor {
+public:
+    size_t Bytes = 0;
+
+    void visit(NumberExprAST*) override { Bytes += sizeof(NumberExprAST); }
+    void visit(VariableExprAST*) override { Bytes += sizeof(VariableExprAST); }
+    void visit(BinaryExprAST* expr) override {
+        WalkBinaryTree(
+            expr,
+            [&](ExprPtr& Operand) {
+                Operand->accept(*this);
+                return true;
+            },
+            [&](BinaryExprAST*, ExprPtr*) {
+                Bytes += sizeof(BinaryExprAST);
+                return true;
+            });
+    }
+    void visit(ReturnExprAST* expr) override {
+        Bytes += sizeof(ReturnExprAST);
+        expr->getExpr()->accept(*this);
+    }
+    void visit(BlockExprAST* expr) override {
+        Bytes += sizeof(BlockExprAST) + expr->getExpressions().capacity() * sizeof(ExprPtr);
+        for (const auto& E : expr->getExpressions())
+            E->accept(*this);
+    }
+    void visit(IfExprAST* expr) override {
+        Bytes += sizeof(IfExprAST);
+        expr->getCond()->accept(*this);
+        expr->getThen()->accept(*this);
+        if (expr->getElse())
+            expr->getElse()->accept(*this);
+    }
+    void visit(WhileExprAST* expr) override {
+        Bytes += sizeof(WhileExprAST);
+        expr->getCond()->accept(*this);
+        expr->getBody()->accept(*this);
+    }
+    void visit(AssignExprAST* expr) override {
+        Bytes += sizeof(AssignExprAST);
+        expr->getValue()->accept(*this);
+    }
+    void visit(CallExprAST* expr) override {
+        Bytes += sizeof(CallExprAST) + expr->getArgs().capacity() * sizeof(ExprPtr);
+        for (const auto& Arg : expr->getArgs())
+            Arg->accept(*this);
+    }
+    void visit(FunctionAST* func) override { func->getBody()->accept(*this); }
+};
+
+static void CountFlatNode(const FlatFunction& F, NodeIndex N, ASTSummary& Result) {
+    ++Result.Nodes;
+    switch (F.kind(N)) {
+        case FlatKind::Number: Result.Literals += F.number(N); break;
+        case FlatKind::Assign: ++Result.Assigns; break;
+        default: break;
+    }
+}
+
+// Parse Source for the layout benchmarks; nullptr (and the benchmark skipped) on error
+static std::unique_ptr<CompilerSession> ParseForLayout(benchmark::State& State,
+                                                       const std::string& Source) {
+    auto Session = std::make_unique<CompilerSession>();
+    Session->setSource(Source);
+    if (!Session->parse()) {
+        State.SkipWithError("parse failed");
+        return nullptr;
+    }
+    return Session;
+}
+
+static std::vector<FlatFunction> Flatten(const CompilerSession& Session) {
+    std::vector<FlatFunction> Flat;
+    for (const auto& Func : Session.getFunctions())
+        Flat.push_back(FlattenFunction(Func.get()));
+    return Flat;
+}
+
+static void SetLayoutCounters(benchmark::State& State, size_t Nodes, size_t Bytes) {
+    State.counters["nodes"] = Rate(Nodes, PerIterationRate);
+    State.counters["bytes_per_node"] = static_cast<double>(Bytes) / Nodes;
+}
+
+static void BM_Flatten(benchmark::State& State, SourceKind Kind) {
+    auto Session = ParseForLayout(State, Generate(Kind, State.range(0)));
+    if (!Session)
+        return;
+    size_t Nodes = 0, Bytes = 0;
+    for (auto _ : State) {
+        std::vector<FlatFunction> Flat = Flatten(*Session);
+        Nodes = Bytes = 0;
+        for (const FlatFunction& F : Flat) {
+            Nodes += F.size();
+            Bytes += F.getBytesAllocated();
+        }
+        benchmark::DoNotOptimize(Flat.data());
+    }
+    SetLayoutCounters(State, Nodes, Bytes);
+}
+
+static void BM_TraverseTree(benchmark::State& State, SourceKind Kind) {
+    auto Session = ParseForLayout(State, Generate(Kind, State.range(0)));
+    if (!Session)
+        return;
+    ASTSummary Summary;
+    for (auto _ : State) {
+        TreeSummary Pass;
+        for (const auto& Func : Session->getFunctions())
+            Func->accept(Pass);
+        Summary = Pass.Result;
+        benchmark::DoNotOptimize(Summary);
+    }
+    TreeBytes Size;
+    for (const auto& Func : Session->getFunctions())
+        Func->accept(Size);
+    SetLayoutCounters(State, Summary.Nodes, Size.Bytes);
+}
+
+// range(1) selects the traversal: 0 walks from the root, 1 scans the arrays in order
+static void BM_TraverseFlat(benchmark::State& State, SourceKind Kind) {
+    auto Session = ParseForLayout(State, Generate(Kind, State.range(0)));
+    if (!Session)
+        return;
+    std::vector<FlatFunction> Flat = Flatten(*Session);
+    bool Scan = State.range(1) != 0;
+    ASTSummary Summary;
+    for (auto _ : State) {
+        Summary = ASTSummary();
+        for (const FlatFunction& F : Flat) {
+            if (Scan) {
+                for (NodeIndex N = 0, E = static_cast<NodeIndex>(F.size()); N != E; ++N)
+                    CountFlatNode(F, N, Summary);
+            } else {
+                WalkFlatFunction(F, [&](NodeIndex N) { CountFlatNode(F, N, Summary); });
+            }
+        }
+        benchmark::DoNotOptimize(Summary);
+    }
+    size_t Bytes = 0;
+    for (const FlatFunction& F : Flat)
+        Bytes += F.getBytesAllocated();
+    SetLayoutCounters(State, Summary.Nodes, Bytes);
+}
+
+// The stack-slot analysis codegen runs on every function, on each layout
+static void BM_AssignedNamesTree(benchmark::State& State, SourceKind Kind) {
+    auto Session = ParseForLayout(State, Generate(Kind, State.range(0)));
+    if (!Session)
+        return;
+    for (auto _ : State)
+        for (const auto& Func : Session->getFunctions())
+            benchmark::DoNotOptimize(CollectAssignedNames(Func.get()));
+    State.counters["nodes"] = Rate(Session->getArena().getNodeCount(), PerIterationRate);
+}
+
+static void BM_AssignedNamesFlat(benchmark::State& State, SourceKind Kind) {
+    auto Session = ParseForLayout(State, Generate(Kind, State.range(0)));
+    if (!Session)
+        return;
+    std::vector<FlatFunction> Flat = Flatten(*Session);
+    for (auto _ : State)
+        for (const FlatFunction& F : Flat)
+            benchmark::DoNotOptimize(CollectAssignedSymbols(F));
+    State.counters["nodes"] = Rate(Session->getArena().getNodeCount(), PerIterationRate);
+}
+
+BENCHMARK_CAPTURE(BM_Lex, deep, Deep)->Arg(2000);
+BENCHMARK_CAPTURE(BM_Lex, wide, Wide)->Arg(10000);
+BENCHMARK_CAPTURE(BM_Lex, many, Many)->Arg(1000);
+
+BENCHMARK_CAPTURE(BM_Parse, deep, Deep)->Arg(2000);
+BENCHMARK_CAPTURE(BM_Parse, wide, Wide)->Arg(10000);
+BENCHMARK_CAPTURE(BM_Parse, many, Many)->Arg(1000);
+
+BENCHMARK_CAPTURE(BM_Codegen, deep, Deep)->Arg(2000);
+BENCHMARK_CAPTURE(BM_Codegen, wide, Wide)->Arg(10000);
+BENCHMARK_CAPTURE(BM_Codegen, many, Many)->Arg(1000);
+
+BENCHMARK_CAPTURE(BM_Optimize, many, Many)->Args({100, 0})->Args({100, 2})->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_ParallelBuild, many, Many)
+    ->ArgsProduct({{1000}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_JITCompile, many, Many)
+    ->Args({1, 0})
+    ->Args({1, 2})
+    ->Args({100, 2})
+    ->Unit(benchmark::kMicrosecond);
+
+// About a million AST nodes each
+BENCHMARK_CAPTURE(BM_Flatten, deep, Deep)->Arg(500000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Flatten, wide, Wide)->Arg(120000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Flatten, many, Many)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_TraverseTree, deep, Deep)->Arg(500000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseTree, wide, Wide)->Arg(120000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseTree, many, Many)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_TraverseFlat, deep, Deep)
+    ->ArgsProduct({{500000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseFlat, wide, Wide)
+    ->ArgsProduct({{120000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseFlat, many, Many)
+    ->ArgsProduct({{20000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_AssignedNamesTree, wide, Wide)->Arg(120000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_AssignedNamesTree, many, Many)->Arg(20000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_AssignedNamesFlat, wide, Wide)->Arg(120000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_AssignedNamesFlat, many, Many)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_EvalScalar)->Arg(1 << 16);
+BENCHMARK(BM_EvalBatch)->Arg(1 << 16);
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::strcmp(argv[1], "--generate") == 0) {
+        SourceKind Kind;
+        if (std::strcmp(argv[2], "deep") == 0)
+            Kind = Deep;
+        else if (std::strcmp(argv[2], "wide") == 0)
+            Kind = Wide;
+        else if (std::strcmp(argv[2], "many") == 0)
+            Kind = Many;
+        else {
+            std::cerr << "Unknown source kind " << argv[2] << " (deep, wide or many)\n";
+            return 1;
+        }
+        std::cout << Generate(Kind, std::strtoull(argv[3], nullptr, 10));
+        return 0;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "source_gen.hpp"
+
+static const char BinaryOps[] = {'+', '*', '-', '/'};
+
+std::string GenerateDeepExpression(size_t Depth) {
+    // Left-nested parentheses: every level is one more BinaryExprAST on the spine
+    std::string Src = "func deep(x, y) {\n  return ";
+    Src.reserve(Depth * 12 + 64);
+    Src.append(Depth, '(');
+    Src += "x";
+    for (size_t i = 0; i < Depth; ++i) {
+        Src += ' ';
+        Src += BinaryOps[i % 4];
+        Src += i % 3 == 0 ? " y)" : " " + std::to_string(i % 7 + 1) + ")";
+    }
+    Src += ";\n}\n";
+    return Src;
+}
+
+std::string GenerateWideBlock(size_t Statements) {
+    std::string Src = "func wide(x, y) {\n  a = x;\n  b = y;\n";
+    Src.reserve(Statements * 32 + 64);
+    for (size_t i = 0; i < Statements; ++i) {
+        if (i % 2 == 0)
+            Src += "  a = a * 1.5 + b - " + std::to_string(i % 97) + ";\n";
+        else
+            Src += "  b = (b + a) / 2.25 - x * y;\n";
+    }
+    Src += "  return a + b;\n}\n";
+    return Src;
+}
+
+std::string GenerateManyFunctions(size_t Count) {
+    std::string Src;
+    Src.reserve(Count * 160);
+    for (size_t i = 0; i < Count; ++i) {
+        std::string Name = "f" + std::to_string(i);
+        std::string K = std::to_string(i % 13 + 1);
+        Src += "func " + Name + "(x, y) {\n";
+        Src += "  a = x * " + K + " + y;\n";
+        Src += "  if (a < " + K + ") { a = a + y * 0.5; } else { a = a - 1; }\n";
+        Src += "  n = 0;\n";
+        Src += "  while (n < 4) { a = a * 0.75 + n; n = n + 1; }\n";
+        if (i > 0)
+            Src += "  a = a + f" + std::to_string(i - 1) + "(y, a);\n";
+        Src += "  return a * a - x;\n}\n";
+    }
+    return Src;
+}
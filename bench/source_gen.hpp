@@ -0,0 +1,19 @@
+#ifndef SOURCE_GEN_HPP
+#define SOURCE_GEN_HPP
+
+#include <cstddef>
+#include <string>
+
+// Synthetic my_lang sources for the benchmarks. Output depends only on the
+// arguments, so numbers from different builds compare like for like.
+
+// func deep(x, y) { return ((((x + 1) * y) - 2) / ...); } -- Depth nested binary operators
+std::string GenerateDeepExpression(size_t Depth);
+
+// func wide(x, y) { a = x * 1.5 + y; b = a - y / 2; ...; return a; } -- Statements statements
+std::string GenerateWideBlock(size_t Statements);
+
+// Count functions with arithmetic, if/while and calls to the previous function
+std::string GenerateManyFunctions(size_t Count);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "ast.hpp"
+#include "symbols.hpp"
+#include <string_view>
+#include <utility>
+
+#include "llvm/Support/Allocator.h"
+
+/**
+ * Bump-pointer arena owned by a compile session, together with the
+ * session's SymbolTable. AST nodes are carved out of large slabs
+ * and released together when the arena is destroyed, instead of one
+ * malloc/free per node. Every node made by an arena must be destroyed
+ * before the arena itself.
+ */
+class ASTArena {
+    llvm::BumpPtrAllocator Allocator;
+    SymbolTable Symbols;
+    bool AllocateNodes;
+    size_t NodeCount = 0;
+
+public:
+    // With AllocateNodes == false nodes go to the heap (names are still interned)
+    explicit ASTArena(bool AllocateNodes = true) : AllocateNodes(AllocateNodes) {}
+
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+
+    template <typename T, typename... Args>
+    ASTPtr<T> make(Args&&... args) {
+        ++NodeCount;
+        if (!AllocateNodes)
+            return MakeAST<T>(std::forward<Args>(args)...);
+
+        void* Mem = Allocator.Allocate(sizeof(T), alignof(T));
+        return ASTPtr<T>(new (Mem) T(std::forward<Args>(args)...), ASTDeleter{true});
+    }
+
+    // The session-wide ID of Name
+    SymbolID intern(std::string_view Name) { return Symbols.intern(Name); }
+    const SymbolTable& getSymbols() const { return Symbols; }
+
+    size_t getBytesAllocated() const {
+        return Allocator.getBytesAllocated() + Symbols.getBytesAllocated();
+    }
+
+    // Nodes made so far, whether in the arena or on the heap
+    size_t getNodeCount() const { return NodeCount; }
+};
+
+#endif
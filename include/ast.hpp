@@ -3,11 +3,39 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <typeinfo>
 #include <vector>
+#include "symbols.hpp"
+
+#include "llvm/ADT/SmallVector.h"
 
 // Forward declaration
 class CodegenVisitor;
 
+// Deleter for AST nodes. Heap nodes are deleted; nodes placed in an ASTArena
+// are only destroyed, since the arena releases their memory in bulk.
+struct ASTDeleter {
+    bool InArena = false;
+
+    template <typename T>
+    void operator()(T* Node) const {
+        if (InArena)
+            Node->~T();
+        else
+            delete Node;
+    }
+};
+
+template <typename T>
+using ASTPtr = std::unique_ptr<T, ASTDeleter>;
+
+// Allocate an AST node on the heap (see ASTArena::make for arena allocation)
+template <typename T, typename... Args>
+ASTPtr<T> MakeAST(Args&&... args) {
+    return ASTPtr<T>(new T(std::forward<Args>(args)...));
+}
+
 // Base expression class
 class ExprAST {
 public:
@@ -17,6 +45,8 @@ public:
     virtual void accept(CodegenVisitor& visitor) = 0;
 };
 
+using ExprPtr = ASTPtr<ExprAST>;
+
 // Expression class for numeric literals
 class NumberExprAST : public ExprAST {
     double Val;
@@ -28,74 +58,227 @@ public:
     void accept(CodegenVisitor& visitor) override;
 };
 
-// Expression class for referencing variables
+// Expression class for referencing variables.
+// The name is a SymbolID in the SymbolTable of the enclosing FunctionAST.
 class VariableExprAST : public ExprAST {
-    std::string Name;
+    SymbolID Name;
 
 public:
-    VariableExprAST(const std::string &Name) : Name(Name) {}
-    const std::string& getName() const { return Name; }
+    VariableExprAST(SymbolID Name) : Name(Name) {}
+    SymbolID getName() const { return Name; }
     
     void accept(CodegenVisitor& visitor) override;
 };
 
 // Expression class for binary operators
-class BinaryExprAST : public ExprAST {
+class BinaryExprAST final : public ExprAST {
     char Op;
-    std::unique_ptr<ExprAST> LHS, RHS;
+    ExprPtr LHS, RHS;
 
 public:
-    BinaryExprAST(char Op, std::unique_ptr<ExprAST> LHS, std::unique_ptr<ExprAST> RHS)
+    BinaryExprAST(char Op, ExprPtr LHS, ExprPtr RHS)
         : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
+
+    // Frees nested operators iteratively, so deep trees cannot overflow the stack
+    ~BinaryExprAST() override;
     
     char getOperator() const { return Op; }
     ExprAST* getLHS() const { return LHS.get(); }
     ExprAST* getRHS() const { return RHS.get(); }
+
+    // Owning slots, for passes that rewrite the tree
+    ExprPtr& getLHSPtr() { return LHS; }
+    ExprPtr& getRHSPtr() { return RHS; }
     
     void accept(CodegenVisitor& visitor) override;
 };
 
+// Operators the code generators implement directly; every other operator is
+// user-defined and lowered to a call of OperatorFunctionName(Op)
+inline bool IsBuiltinBinop(char Op) {
+    return Op == '+' || Op == '-' || Op == '*' || Op == '/' || Op == '<';
+}
+
+// Name of the function defined by 'func binary<Op> ...'
+inline std::string OperatorFunctionName(char Op) { return std::string("binary") + Op; }
+
+// E as a BinaryExprAST, or nullptr. An exact type check, cheaper than dynamic_cast
+// on the hot paths that walk every operator (BinaryExprAST has no subclasses).
+inline BinaryExprAST* AsBinary(ExprAST* E) {
+    return E && typeid(*E) == typeid(BinaryExprAST) ? static_cast<BinaryExprAST*>(E) : nullptr;
+}
+
+/**
+ * Post-order walk over the tree of BinaryExprAST nodes rooted at Root, using an
+ * explicit stack so arbitrarily deep expressions cannot overflow the call stack.
+ *
+ * Operand(ExprPtr& Slot) is called for every operand that is not itself a
+ * BinaryExprAST, left to right; Binary(BinaryExprAST* Node, ExprPtr* Slot) is
+ * called for each operator after both of its operands, with the slot owning
+ * Node (nullptr for Root). Callbacks may replace the node in their slot.
+ * Either callback returns false to stop the walk; the result is then false.
+ */
+template <typename OperandFn, typename BinaryFn>
+bool WalkBinaryTree(BinaryExprAST* Root, OperandFn&& Operand, BinaryFn&& Binary) {
+    struct Frame {
+        ExprPtr* Slot;        // owning slot; nullptr for Root
+        BinaryExprAST* Node;  // nullptr for an operand
+        bool Expanded;        // operands already pushed
+    };
+    llvm::SmallVector<Frame, 16> Stack;
+    Stack.push_back({nullptr, Root, false});
+
+    while (!Stack.empty()) {
+        Frame F = Stack.pop_back_val();
+        if (!F.Node) {
+            if (!Operand(*F.Slot))
+                return false;
+            continue;
+        }
+        if (F.Expanded) {
+            if (!Binary(F.Node, F.Slot))
+                return false;
+            continue;
+        }
+
+        // Revisit the node after its operands; RHS is pushed first so LHS runs first
+        Stack.push_back({F.Slot, F.Node, true});
+        for (ExprPtr* Child : {&F.Node->getRHSPtr(), &F.Node->getLHSPtr()})
+            Stack.push_back({Child, AsBinary(Child->get()), false});
+    }
+    return true;
+}
+
 // Expression class for return statements
 class ReturnExprAST : public ExprAST {
-    std::unique_ptr<ExprAST> Expr;
+    ExprPtr Expr;
 
 public:
-    ReturnExprAST(std::unique_ptr<ExprAST> Expr) : Expr(std::move(Expr)) {}
+    ReturnExprAST(ExprPtr Expr) : Expr(std::move(Expr)) {}
     ExprAST* getExpr() const { return Expr.get(); }
+    ExprPtr& getExprPtr() { return Expr; }
     
     void accept(CodegenVisitor& visitor) override;
 };
 
 // Expression class for blocks of code (multiple expressions)
 class BlockExprAST : public ExprAST {
-    std::vector<std::unique_ptr<ExprAST>> Expressions;
+    std::vector<ExprPtr> Expressions;
     
 public:
-    BlockExprAST(std::vector<std::unique_ptr<ExprAST>> Expressions)
+    BlockExprAST(std::vector<ExprPtr> Expressions)
         : Expressions(std::move(Expressions)) {}
     
-    const std::vector<std::unique_ptr<ExprAST>>& getExpressions() const { return Expressions; }
+    const std::vector<ExprPtr>& getExpressions() const { return Expressions; }
+    std::vector<ExprPtr>& getExpressions() { return Expressions; }
     
     void accept(CodegenVisitor& visitor) override;
 };
 
-// Full function definition
+// Expression class for 'if (Cond) { Then } else { Else }'.
+// Yields the value of the branch taken; Else may be null, yielding 0.0.
+class IfExprAST : public ExprAST {
+    ExprPtr Cond, Then, Else;
+
+public:
+    IfExprAST(ExprPtr Cond, ExprPtr Then, ExprPtr Else)
+        : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
+
+    ExprAST* getCond() const { return Cond.get(); }
+    ExprAST* getThen() const { return Then.get(); }
+    ExprAST* getElse() const { return Else.get(); }
+
+    ExprPtr& getCondPtr() { return Cond; }
+    ExprPtr& getThenPtr() { return Then; }
+    ExprPtr& getElsePtr() { return Else; }
+
+    void accept(CodegenVisitor& visitor) override;
+};
+
+// Expression class for 'while (Cond) { Body }'; yields 0.0
+class WhileExprAST : public ExprAST {
+    ExprPtr Cond, Body;
+
+public:
+    WhileExprAST(ExprPtr Cond, ExprPtr Body) : Cond(std::move(Cond)), Body(std::move(Body)) {}
+
+    ExprAST* getCond() const { return Cond.get(); }
+    ExprAST* getBody() const { return Body.get(); }
+
+    ExprPtr& getCondPtr() { return Cond; }
+    ExprPtr& getBodyPtr() { return Body; }
+
+    void accept(CodegenVisitor& visitor) override;
+};
+
+// Expression class for 'Name = Value'; yields Value.
+// Assigning to a name that is not an argument declares a local initialized to 0.0.
+class AssignExprAST : public ExprAST {
+    SymbolID Name;
+    ExprPtr Value;
+
+public:
+    AssignExprAST(SymbolID Name, ExprPtr Value) : Name(Name), Value(std::move(Value)) {}
+
+    SymbolID getName() const { return Name; }
+    ExprAST* getValue() const { return Value.get(); }
+    ExprPtr& getValuePtr() { return Value; }
+
+    void accept(CodegenVisitor& visitor) override;
+};
+
+// Expression class for calls, 'Callee(Args...)'.
+// Callee is a SymbolID like variable names; it may be defined later in the translation
+// unit or, for the JIT and native output, resolved from the host (e.g. libm).
+class CallExprAST : public ExprAST {
+    SymbolID Callee;
+    std::vector<ExprPtr> Args;
+
+public:
+    CallExprAST(SymbolID Callee, std::vector<ExprPtr> Args)
+        : Callee(Callee), Args(std::move(Args)) {}
+
+    SymbolID getCallee() const { return Callee; }
+    const std::vector<ExprPtr>& getArgs() const { return Args; }
+    std::vector<ExprPtr>& getArgs() { return Args; }
+
+    void accept(CodegenVisitor& visitor) override;
+};
+
+// Full function definition. Symbols resolves the SymbolIDs of its arguments
+// and body (usually the session's table, see ASTArena) and must outlive it.
 class FunctionAST {
     std::string Name;
-    std::vector<std::string> Args;
-    std::unique_ptr<ExprAST> Body;
+    std::vector<SymbolID> Args;
+    ExprPtr Body;
+    const SymbolTable* Symbols;
+    std::vector<SymbolID> DeclaredLocals;
 
 public:
-    FunctionAST(const std::string &Name, std::vector<std::string> Args, std::unique_ptr<ExprAST> Body)
-        : Name(Name), Args(std::move(Args)), Body(std::move(Body)) {}
+    FunctionAST(const std::string &Name, std::vector<SymbolID> Args, ExprPtr Body,
+                const SymbolTable& Symbols)
+        : Name(Name), Args(std::move(Args)), Body(std::move(Body)), Symbols(&Symbols) {}
     
     const std::string& getName() const { return Name; }
-    const std::vector<std::string>& getArgs() const { return Args; }
+    const std::vector<SymbolID>& getArgs() const { return Args; }
+    const SymbolTable& getSymbols() const { return *Symbols; }
     ExprAST* getBody() const { return Body.get(); }
+    ExprPtr& getBodyPtr() { return Body; }
+
+    // A local that needs a slot even if no assignment to it is left in the body,
+    // e.g. one assigned only in code the simplifier removed. It reads as 0.0.
+    void declareLocal(SymbolID Local) { DeclaredLocals.push_back(Local); }
+    const std::vector<SymbolID>& getDeclaredLocals() const { return DeclaredLocals; }
     
     void accept(CodegenVisitor& visitor);
 };
 
+// Append the names assigned in E that are not in Names yet, in first-assignment order
+void CollectAssignedNames(ExprAST* E, std::vector<SymbolID>& Names);
+
+// Append the calls in E in the order the code generator reaches them
+void CollectCalls(ExprAST* E, std::vector<CallExprAST*>& Calls);
+
 // Visitor interface for code generation
 class CodegenVisitor {
 public:
@@ -106,6 +289,10 @@ public:
     virtual void visit(BinaryExprAST* expr) = 0;
     virtual void visit(ReturnExprAST* expr) = 0;
     virtual void visit(BlockExprAST* expr) = 0;
+    virtual void visit(IfExprAST* expr) = 0;
+    virtual void visit(WhileExprAST* expr) = 0;
+    virtual void visit(AssignExprAST* expr) = 0;
+    virtual void visit(CallExprAST* expr) = 0;
     virtual void visit(FunctionAST* func) = 0;
 };
 
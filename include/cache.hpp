@@ -0,0 +1,83 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include "optimizer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+/**
+ * Content-addressed on-disk cache of compiled translation units.
+ *
+ * Entries are files named by their key. Each hit refreshes the entry's
+ * modification time, and store() evicts the least recently used entries
+ * once the directory grows past MaxBytes, so the LRU order survives
+ * restarts without a separate index. Entries are written to a temporary
+ * file and renamed into place, so concurrent compilers sharing a
+ * directory never see a partial entry.
+ */
+class CodeCache {
+    std::string Dir;
+    uint64_t MaxBytes;
+
+    std::atomic<uint64_t> Hits{0};
+    std::atomic<uint64_t> Misses{0};
+    std::mutex EvictMutex;
+
+    std::string entryPath(const std::string& Key) const;
+    void evict();
+
+public:
+    static constexpr uint64_t DefaultMaxBytes = 256ull << 20;
+
+    explicit CodeCache(std::string Dir, uint64_t MaxBytes = DefaultMaxBytes)
+        : Dir(std::move(Dir)), MaxBytes(MaxBytes) {}
+
+    // Create the cache directory; returns false on error
+    bool init();
+
+    // Return the entry for Key and mark it most recently used (nullptr on a miss)
+    std::unique_ptr<llvm::MemoryBuffer> lookup(const std::string& Key);
+
+    // Add or replace the entry for Key, then evict down to MaxBytes; returns false on error
+    bool store(const std::string& Key, llvm::StringRef Data);
+
+    uint64_t getHits() const { return Hits; }
+    uint64_t getMisses() const { return Misses; }
+
+    // Number of entries and their total size currently on disk
+    std::pair<size_t, uint64_t> getUsage() const;
+};
+
+/**
+ * Hash a translation unit together with everything that affects the code
+ * generated for it. The source is hashed as its token stream, so edits to
+ * comments, whitespace or number spelling (1 vs 1.0) still hit the cache,
+ * and no parsing is needed to compute the key.
+ */
+std::string ComputeCacheKey(std::string_view Source, const llvm::TargetMachine& TM,
+                            unsigned OptLevel, bool FastMath, bool WithBatchKernel,
+                            VectorLibrary VecLib = VectorLibrary::None);
+
+// A cached native object plus the signatures of the functions it defines,
+// so a hit can be called or linked without parsing the source
+struct CachedObject {
+    std::vector<std::pair<std::string, unsigned>> Functions; // name, arity
+    std::string Object;
+
+    std::string serialize() const;
+
+    // Returns false if Data is not a valid entry
+    bool deserialize(llvm::StringRef Data);
+};
+
+#endif
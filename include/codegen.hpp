@@ -3,39 +3,197 @@
 
 #include "ast.hpp"
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Functions called from textual IR, in first-call order, with the arity of the call
+using CalledFunctionMap = llvm::MapVector<std::string, unsigned, std::map<std::string, unsigned>>;
 
 // LLVM IR Code Generator using visitor pattern
+// Writes textual IR straight to an output stream; kept as a debug dump of the AST.
 class LLVMIRGenerator : public CodegenVisitor {
 private:
-    std::string Output;
+    llvm::raw_ostream& Out;
+    std::string LastValue; // operand naming the last expression's result
+    std::string CurrentBlock; // label of the block being emitted, for phi operands
+    const SymbolTable* Symbols = nullptr; // names of the function being printed
+    llvm::DenseSet<SymbolID> MutableVars; // names with a %name.addr stack slot
+    CalledFunctionMap* Calls; // every callee, if requested
     int TempVarCounter = 0;
+    int LabelCounter = 0;
     bool HasReturn = false;
-    
+
     // Generate a unique temporary variable name
     std::string getNextTempVar() {
         return "%t" + std::to_string(TempVarCounter++);
     }
 
+    // Start a new basic block
+    void emitLabel(const std::string& Label) {
+        Out << Label << ":\n";
+        CurrentBlock = Label;
+    }
+
+    // Emit one operator on two operands into LastValue; false for an unknown operator
+    bool emitBinary(char Op, const std::string& lhsVar, const std::string& rhsVar);
+
+    void noteCall(const std::string& Callee, unsigned Arity) {
+        if (Calls)
+            Calls->insert({Callee, Arity});
+    }
+
 public:
-    LLVMIRGenerator() : HasReturn(false) {}
-    
+    // Calls, if given, collects every function called, e.g. to print declarations
+    explicit LLVMIRGenerator(llvm::raw_ostream& Out, CalledFunctionMap* Calls = nullptr)
+        : Out(Out), Calls(Calls) {}
+
     // Implementation of visitor methods
     void visit(NumberExprAST* expr) override;
     void visit(VariableExprAST* expr) override;
     void visit(BinaryExprAST* expr) override;
     void visit(ReturnExprAST* expr) override;
     void visit(BlockExprAST* expr) override;
+    void visit(IfExprAST* expr) override;
+    void visit(WhileExprAST* expr) override;
+    void visit(AssignExprAST* expr) override;
+    void visit(CallExprAST* expr) override;
     void visit(FunctionAST* func) override;
-    
-    // Get the generated LLVM IR
-    std::string getIR() const { return Output; }
-    
+
     // Check if a return statement was processed
     bool hasReturn() const { return HasReturn; }
     void setHasReturn(bool value) { HasReturn = value; }
 };
 
-void GenerateLLVMIR(FunctionAST* func);
+// Arity of every function in a translation unit, by name. Lets code generated
+// for part of a unit into a separate module declare calls into the rest of it
+// with the right signature.
+using PrototypeMap = llvm::StringMap<unsigned>;
+
+// LLVM IR Code Generator that builds an in-memory llvm::Module through
+// llvm::IRBuilder, so the result can be handed to LLVM without reparsing.
+class LLVMModuleGenerator : public CodegenVisitor {
+private:
+    llvm::LLVMContext& Context;
+    llvm::Module& TheModule;
+    llvm::IRBuilder<> Builder;
+    const PrototypeMap* Prototypes;
+
+    const SymbolTable* Symbols = nullptr; // names of the function being generated
+
+    // Values of the function being generated, indexed by SymbolID: an argument that
+    // is never assigned maps to its SSA value, an assigned name to its AllocaInst slot.
+    // Kept across functions so a reused generator does not reallocate it; only the
+    // BoundSymbols entries are reset.
+    std::vector<llvm::Value*> NamedValues;
+    std::vector<SymbolID> BoundSymbols;
+
+    // Value produced by the most recently visited expression (nullptr on error)
+    llvm::Value* LastValue = nullptr;
+    llvm::Function* LastFunction = nullptr;
+
+    // The current block already ends in a return, so nothing more may be emitted into it
+    bool HasReturn = false;
+
+    // Turn a double condition into an i1 (true when non-zero, NaN included)
+    llvm::Value* emitCondition(ExprAST* Cond, const char* Name);
+
+    // Emit one operator on two values; nullptr for an unknown operator
+    llvm::Value* emitBinary(char Op, llvm::Value* L, llvm::Value* R);
+
+    // Drop a function whose body failed to generate
+    void discardFunction(llvm::Function* F);
+
+    llvm::Value* lookup(SymbolID Name) const {
+        return Name < NamedValues.size() ? NamedValues[Name] : nullptr;
+    }
+    void bind(SymbolID Name, llvm::Value* V);
+
+public:
+    // With FastMath every floating-point instruction carries the 'fast' flags.
+    // Prototypes, if given, types calls to functions defined outside M.
+    LLVMModuleGenerator(llvm::Module& M, bool FastMath = false,
+                        const PrototypeMap* Prototypes = nullptr)
+        : Context(M.getContext()), TheModule(M), Builder(M.getContext()), Prototypes(Prototypes) {
+        if (FastMath) {
+            llvm::FastMathFlags FMF;
+            FMF.setFast();
+            Builder.setFastMathFlags(FMF);
+        }
+    }
+
+    void visit(NumberExprAST* expr) override;
+    void visit(VariableExprAST* expr) override;
+    void visit(BinaryExprAST* expr) override;
+    void visit(ReturnExprAST* expr) override;
+    void visit(BlockExprAST* expr) override;
+    void visit(IfExprAST* expr) override;
+    void visit(WhileExprAST* expr) override;
+    void visit(AssignExprAST* expr) override;
+    void visit(CallExprAST* expr) override;
+    void visit(FunctionAST* func) override;
+
+    // The function emitted by the last visit(FunctionAST*), or nullptr if it failed verification
+    llvm::Function* getFunction() const { return LastFunction; }
+
+    // Emit func and apply ApplyInliningPolicy; nullptr on error. One generator
+    // may emit any number of functions into its module.
+    llvm::Function* generate(FunctionAST* func);
+};
+
+// Emit "<name>_batch", a loop that evaluates Scalar over column arrays:
+//   void <name>_batch(const double* x, const double* y, ..., double* out, size_t n)
+// Pointers are noalias and Scalar is marked alwaysinline, so after optimization
+// the loop body is the scalar expression and the loop vectorizer can widen it.
+llvm::Function* GenerateBatchKernel(llvm::Function* Scalar);
+
+// Names assigned anywhere in func, in first-assignment order, followed by its
+// declared locals (see FunctionAST::declareLocal). Only these need a stack slot;
+// every other name is an argument used directly as an SSA value.
+std::vector<SymbolID> CollectAssignedNames(FunctionAST* func);
+
+// Print the textual IR for a translation unit (debug dump): every function, then a
+// declaration of each intrinsic and outside function they call, as llvm-as requires.
+// OS receives nothing but IR, so it can be written straight to an -o file.
+void GenerateLLVMIR(const std::vector<std::unique_ptr<FunctionAST>>& Functions,
+                    llvm::raw_ostream& OS);
+
+// Emit a function into Module; returns nullptr on error.
+// Calls to functions not yet defined in Module become declarations that a later
+// definition fills in; their arity comes from Prototypes when it lists them, otherwise
+// from the call. Small leaf functions are marked alwaysinline (see ApplyInliningPolicy).
+llvm::Function* GenerateLLVMFunction(FunctionAST* func, llvm::Module& Module, bool FastMath = false,
+                                     const PrototypeMap* Prototypes = nullptr);
+
+// A math function built into the language, lowered to an llvm.* intrinsic on double.
+// The optimizer constant-folds these and the vectorizer widens them: sqrt/fabs/fma/
+// minnum/maxnum to vector instructions, the rest to a vector math library if one is
+// selected (see VectorLibrary), otherwise to calls into libm per lane.
+struct MathBuiltin {
+    const char* Name;
+    llvm::Intrinsic::ID ID;
+    unsigned Arity;
+};
+
+// The builtin called Name, or nullptr. Builtin names cannot be redefined.
+const MathBuiltin* FindMathBuiltin(std::string_view Name);
+
+// Functions with at most this many instructions and no calls are always inlined
+constexpr unsigned AlwaysInlineMaxInstructions = 32;
+
+// Mark F alwaysinline if it is a small leaf function. Larger functions and
+// functions with calls are left to the cost-model inliner of the -O1+ pipelines.
+void ApplyInliningPolicy(llvm::Function* F);
 
 #endif
@@ -0,0 +1,145 @@
+#ifndef FLAT_AST_HPP
+#define FLAT_AST_HPP
+
+#include "ast.hpp"
+#include "symbols.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+
+// Kind tag of a FlatFunction node, one per ExprAST subclass
+enum class FlatKind : uint8_t { Number, Variable, Binary, Return, Block, If, While, Assign, Call };
+
+// Position of a node in a FlatFunction
+using NodeIndex = uint32_t;
+constexpr NodeIndex NoNode = ~NodeIndex(0);
+
+/**
+ * Compact, index-based form of a function body: the same tree as FunctionAST,
+ * stored as parallel arrays instead of heap nodes linked by pointers.
+ *
+ * Node N is Kinds[N] plus three 32-bit fields, 13 bytes in total:
+ *   Payload  Number: index into Numbers; Variable, Assign, Call: SymbolID;
+ *            Binary: operator character
+ *   First    Binary: LHS; Return, Assign: value; If, While: condition;
+ *            Block, Call: start of the children in Lists
+ *   Second   Binary: RHS; While: body; If: start of {Then, Else} in Lists;
+ *            Block, Call: number of children
+ * Nodes are stored in post-order, so every operand precedes its user and a
+ * single forward scan over the arrays visits the whole tree bottom-up. Passes
+ * dispatch on the kind with a switch instead of virtual calls.
+ */
+class FlatFunction {
+    std::string Name;
+    std::vector<SymbolID> Args;
+    const SymbolTable* Symbols;
+    std::vector<SymbolID> DeclaredLocals; // see FunctionAST::declareLocal
+    NodeIndex Root = NoNode;
+
+    std::vector<FlatKind> Kinds;
+    std::vector<uint32_t> Payload;
+    std::vector<NodeIndex> First, Second;
+
+    // Side tables
+    std::vector<double> Numbers;
+    std::vector<NodeIndex> Lists; // Block and Call children, If branches (Else may be NoNode)
+
+    friend class Flattener;
+
+public:
+    FlatFunction(std::string Name, std::vector<SymbolID> Args, const SymbolTable& Symbols)
+        : Name(std::move(Name)), Args(std::move(Args)), Symbols(&Symbols) {}
+
+    const std::string& getName() const { return Name; }
+    const std::vector<SymbolID>& getArgs() const { return Args; }
+    const SymbolTable& getSymbols() const { return *Symbols; }
+    const std::vector<SymbolID>& getDeclaredLocals() const { return DeclaredLocals; }
+
+    // The body; it is also the last node
+    NodeIndex getRoot() const { return Root; }
+    size_t size() const { return Kinds.size(); }
+
+    FlatKind kind(NodeIndex N) const { return Kinds[N]; }
+    double number(NodeIndex N) const { return Numbers[Payload[N]]; }
+    SymbolID symbol(NodeIndex N) const { return Payload[N]; }
+    char op(NodeIndex N) const { return static_cast<char>(Payload[N]); }
+
+    NodeIndex lhs(NodeIndex N) const { return First[N]; }
+    NodeIndex rhs(NodeIndex N) const { return Second[N]; }
+    NodeIndex value(NodeIndex N) const { return First[N]; }
+    NodeIndex cond(NodeIndex N) const { return First[N]; }
+    NodeIndex body(NodeIndex N) const { return Second[N]; }
+    NodeIndex thenBranch(NodeIndex N) const { return Lists[Second[N]]; }
+    NodeIndex elseBranch(NodeIndex N) const { return Lists[Second[N] + 1]; } // NoNode if absent
+
+    // Statements of a Block, arguments of a Call
+    llvm::ArrayRef<NodeIndex> children(NodeIndex N) const {
+        return llvm::ArrayRef<NodeIndex>(Lists).slice(First[N], Second[N]);
+    }
+
+    // Bytes held by the node arrays and side tables
+    size_t getBytesAllocated() const;
+};
+
+// Build the flat form of func. func is not modified and may be freed afterwards.
+FlatFunction FlattenFunction(FunctionAST* func);
+
+// Names assigned anywhere in F, in first-assignment order, by one scan over the
+// nodes, followed by its declared locals (the flat counterpart of the collector
+// the code generator runs)
+std::vector<SymbolID> CollectAssignedSymbols(const FlatFunction& F);
+
+/**
+ * Pre-order walk from the root, left to right, over an explicit stack of
+ * indices. Visit(NodeIndex) is called once per node, for passes that need
+ * parents before children; bottom-up passes can scan 0 .. size() - 1 instead.
+ */
+template <typename VisitFn>
+void WalkFlatFunction(const FlatFunction& F, VisitFn&& Visit) {
+    llvm::SmallVector<NodeIndex, 32> Stack;
+    if (F.getRoot() != NoNode)
+        Stack.push_back(F.getRoot());
+
+    while (!Stack.empty()) {
+        NodeIndex N = Stack.pop_back_val();
+        Visit(N);
+
+        // Children are pushed last to first so the first one is visited next
+        switch (F.kind(N)) {
+            case FlatKind::Number:
+            case FlatKind::Variable:
+                break;
+            case FlatKind::Binary:
+                Stack.push_back(F.rhs(N));
+                Stack.push_back(F.lhs(N));
+                break;
+            case FlatKind::Return:
+            case FlatKind::Assign:
+                Stack.push_back(F.value(N));
+                break;
+            case FlatKind::If:
+                if (F.elseBranch(N) != NoNode)
+                    Stack.push_back(F.elseBranch(N));
+                Stack.push_back(F.thenBranch(N));
+                Stack.push_back(F.cond(N));
+                break;
+            case FlatKind::While:
+                Stack.push_back(F.body(N));
+                Stack.push_back(F.cond(N));
+                break;
+            case FlatKind::Block:
+            case FlatKind::Call: {
+                llvm::ArrayRef<NodeIndex> Children = F.children(N);
+                Stack.append(Children.rbegin(), Children.rend());
+                break;
+            }
+        }
+    }
+}
+
+#endif
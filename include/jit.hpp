@@ -0,0 +1,81 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "ast.hpp"
+#include "optimizer.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+// In-process JIT built on LLVM ORC LLJIT.
+// Compiles FunctionASTs to native code and hands back callable pointers,
+// so embedders can evaluate functions without spawning llc/clang.
+class MyLangJIT {
+    std::unique_ptr<llvm::orc::LLJIT> TheJIT;
+
+    explicit MyLangJIT(std::unique_ptr<llvm::orc::LLJIT> J) : TheJIT(std::move(J)) {}
+
+    // Generate func (and optionally its batch kernel) into a fresh module and add it to the JIT
+    bool addFunction(FunctionAST* func, bool WithBatchKernel);
+
+public:
+    // Initialize the native target and create a JIT that optimizes every module
+    // at OptLevel (0-3) for the host CPU; returns nullptr on error.
+    // With PrintAfterOpt each optimized module is dumped to stderr.
+    // With a VecLib, that library is loaded into the process so vectorized math resolves.
+    // With CompileThreads > 0 modules are optimized and compiled on that many
+    // threads instead of the one that looks them up (see materialize).
+    static std::unique_ptr<MyLangJIT> Create(unsigned OptLevel = 2, bool PrintAfterOpt = false,
+                                             VectorLibrary VecLib = VectorLibrary::None,
+                                             unsigned CompileThreads = 0);
+
+    // Compile a function into the JIT and return its native address (nullptr on error)
+    void* compile(FunctionAST* func);
+
+    // Create an empty library whose symbols are isolated from every other library,
+    // so independent clients can define the same names; returns nullptr on error.
+    // It still resolves host-process symbols through the main library.
+    llvm::orc::JITDylib* createLibrary(const std::string& Name);
+
+    // Free a library made by createLibrary and all code in it; returns false on error
+    bool removeLibrary(llvm::orc::JITDylib* Lib);
+
+    // Add a whole module, e.g. a translation unit from CompilerSession::takeModule(),
+    // to Lib (default: the main library); its functions are then available through
+    // lookup(). Returns false on error
+    bool addModule(llvm::orc::ThreadSafeModule TSM, llvm::orc::JITDylib* Lib = nullptr);
+
+    // Add native object code emitted for the JIT's target, e.g. a CodeCache hit;
+    // it is linked as is, without running the optimizer. Returns false on error
+    bool addObject(std::unique_ptr<llvm::MemoryBuffer> Object);
+
+    // Compile a function together with its "<name>_batch" kernel (see GenerateBatchKernel)
+    // and return the kernel's native address (nullptr on error)
+    void* compileBatch(FunctionAST* func);
+
+    // Look up an already compiled function by name in Lib (default: the main library);
+    // nullptr if not found
+    void* lookup(const std::string& Name, llvm::orc::JITDylib* Lib = nullptr);
+
+    // Compile the modules defining Names in Lib (default: the main library) now,
+    // concurrently when the JIT has compile threads, instead of one at a time as
+    // lookups reach them; returns false on error
+    bool materialize(const std::vector<std::string>& Names, llvm::orc::JITDylib* Lib = nullptr);
+
+    // Typed lookup, e.g. getFunction<double(double, double)>("calculate")
+    template <typename Fn>
+    Fn* getFunction(const std::string& Name) {
+        return reinterpret_cast<Fn*>(lookup(Name));
+    }
+};
+
+// Largest arity CallJITFunction can dispatch
+constexpr size_t MaxJITCallArgs = 8;
+
+// Call a compiled double(double...) function with a runtime argument list.
+// Callers must reject more than MaxJITCallArgs arguments; the result is then NaN.
+double CallJITFunction(void* Addr, const std::vector<double>& Args);
+
+#endif
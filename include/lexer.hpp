@@ -1,7 +1,11 @@
 #ifndef LEXER_HPP
 #define LEXER_HPP
 
+#include <memory>
 #include <string>
+#include <string_view>
+
+#include "llvm/Support/MemoryBuffer.h"
 
 // Token types
 enum Token {
@@ -14,7 +18,7 @@ enum Token {
     // Identifiers and literals
     tok_identifier = -4,
     tok_number = -5,
-    
+
     // Add some additional tokens for future expansion
     tok_if = -6,
     tok_else = -7,
@@ -22,14 +26,81 @@ enum Token {
     tok_semicolon = -9,
 };
 
-// These are defined in lexer.cpp and used elsewhere
-extern std::string IdentifierStr; // For tok_identifier
-extern double NumVal;             // For tok_number
+// A token produced by BufferLexer. Text is a view into the source buffer.
+struct TokenInfo {
+    int Kind = tok_eof;
+    std::string_view Text; // identifier/keyword spelling or number literal
+    double NumVal = 0.0;   // value if Kind == tok_number
+};
+
+/**
+ * Lexer over a contiguous source buffer.
+ * Scans with pointer arithmetic; identifiers and numbers are returned as
+ * views into the buffer, so the buffer must outlive the tokens.
+ */
+class BufferLexer {
+    const char* Cur;
+    const char* End;
+
+public:
+    explicit BufferLexer(std::string_view Source)
+        : Cur(Source.data()), End(Source.data() + Source.size()) {}
+
+    TokenInfo next();
+};
+
+/**
+ * Cuts source text that arrives in arbitrary pieces into top-level
+ * definitions, so a stream can be parsed one 'func' at a time without
+ * holding all of it. A definition ends at the '}' that closes its outermost
+ * brace; braces inside '#' comments are ignored. Each piece of text handed
+ * to Emit is a complete definition together with any comments before it.
+ */
+class DefinitionSplitter {
+    std::string Current; // text of the unfinished definition
+    size_t Depth = 0;
+    bool InComment = false;
+
+public:
+    // Scan the next piece of input, calling Emit for every definition it completes
+    template <typename EmitFn>
+    void feed(std::string_view Text, EmitFn Emit) {
+        size_t Start = 0;
+        for (size_t i = 0; i < Text.size(); ++i) {
+            char C = Text[i];
+            if (InComment) {
+                InComment = C != '\n' && C != '\r';
+            } else if (C == '#') {
+                InComment = true;
+            } else if (C == '{') {
+                ++Depth;
+            } else if (C == '}' && Depth > 0 && --Depth == 0) {
+                Current.append(Text.data() + Start, i + 1 - Start);
+                Start = i + 1;
+                Emit(std::move(Current));
+                Current.clear();
+            }
+        }
+        Current.append(Text.data() + Start, Text.size() - Start);
+    }
+
+    // The input ended: hand over trailing text that is not just whitespace and
+    // comments, e.g. an unclosed definition, so the parser can report it
+    template <typename EmitFn>
+    void finish(EmitFn Emit) {
+        BufferLexer Rest(Current);
+        if (Rest.next().Kind != tok_eof)
+            Emit(std::move(Current));
+        Current.clear();
+        Depth = 0;
+        InComment = false;
+    }
+};
 
 /**
- * Returns the next token from standard input
- * Updates IdentifierStr or NumVal as appropriate
+ * Load a whole source file ("-" for standard input).
+ * Large files are memory-mapped rather than copied. Returns nullptr on error.
  */
-int gettok();
+std::unique_ptr<llvm::MemoryBuffer> LoadSourceFile(const std::string& Path);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,29 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <string_view>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+// Vector math library the loop vectorizer may call for widened sin/cos/exp/log/pow
+enum class VectorLibrary {
+    None,
+    LIBMVEC, // glibc's libmvec (-lmvec)
+    SVML,    // Intel Short Vector Math Library (-lsvml)
+};
+
+// Parse a --veclib value ("none", "libmvec", "svml"); returns false if unknown
+bool ParseVectorLibrary(std::string_view Name, VectorLibrary& Out);
+
+// Shared library that provides VecLib's functions, for dlopen/-l ("" for None)
+const char* VectorLibraryName(VectorLibrary VecLib);
+
+// Run the LLVM new-pass-manager default pipeline for OptLevel (0-3) over Module.
+// -O0 only runs the always-inliner; -O2 and up enable the loop and SLP vectorizers.
+// TM supplies target cost models to the vectorizers; it may be nullptr.
+// With a VecLib, vectorized math intrinsics become calls into that library.
+void OptimizeModule(llvm::Module& Module, unsigned OptLevel, llvm::TargetMachine* TM,
+                    VectorLibrary VecLib = VectorLibrary::None);
+
+#endif
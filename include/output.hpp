@@ -0,0 +1,22 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+
+// Buffer of an output stream from OpenOutputFile. Generated IR is written in
+// many small pieces, and this batches them into few large write(2) calls.
+constexpr size_t OutputBufferSize = 1 << 20;
+
+/**
+ * Open the destination of generated text: the file at Path, or standard
+ * output for "-". Writes go through one buffer straight to the file
+ * descriptor, with no intermediate string and no iostream locking.
+ * Returns nullptr on error. Check has_error() after the final flush().
+ */
+std::unique_ptr<llvm::raw_fd_ostream> OpenOutputFile(const std::string& Path);
+
+#endif
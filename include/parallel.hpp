@@ -0,0 +1,68 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "llvm/ADT/STLExtras.h"
+
+/**
+ * Work-stealing loop over the indices [0, N) on up to Threads threads, the
+ * calling thread included. Each thread starts with its own contiguous block
+ * of indices and, once that is used up, steals the upper half of another
+ * thread's remaining block, so items of very different cost still keep
+ * every thread busy without a shared queue.
+ *
+ * Fn(Index, Thread) runs exactly once per index; Thread (0 .. Threads-1)
+ * identifies the calling thread, e.g. to pick per-thread scratch state.
+ * Items run in no particular order, so results should be stored by index.
+ */
+void ParallelFor(size_t N, unsigned Threads, llvm::function_ref<void(size_t, unsigned)> Fn);
+
+/**
+ * FIFO queue between two pipeline stages. push() blocks while Capacity items
+ * are waiting, so a fast producer cannot run ahead of its consumer and the
+ * memory held between stages stays bounded.
+ */
+template <typename T>
+class BoundedQueue {
+    std::mutex Lock;
+    std::condition_variable NotEmpty, NotFull;
+    std::deque<T> Items;
+    size_t Capacity;
+    bool Closed = false;
+
+public:
+    explicit BoundedQueue(size_t Capacity) : Capacity(Capacity ? Capacity : 1) {}
+
+    void push(T Item) {
+        std::unique_lock<std::mutex> Guard(Lock);
+        NotFull.wait(Guard, [&] { return Items.size() < Capacity; });
+        Items.push_back(std::move(Item));
+        NotEmpty.notify_one();
+    }
+
+    // Wait for the next item; false once the queue is closed and drained
+    bool pop(T& Item) {
+        std::unique_lock<std::mutex> Guard(Lock);
+        NotEmpty.wait(Guard, [&] { return !Items.empty() || Closed; });
+        if (Items.empty())
+            return false;
+        Item = std::move(Items.front());
+        Items.pop_front();
+        NotFull.notify_one();
+        return true;
+    }
+
+    // The producer is done; pop() returns false after the remaining items
+    void close() {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Closed = true;
+        NotEmpty.notify_all();
+    }
+};
+
+#endif
@@ -1,12 +1,97 @@
 #ifndef PARSER_HPP
 #define PARSER_HPP
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <string_view>
+#include <vector>
+#include "arena.hpp"
 #include "ast.hpp"
+#include "lexer.hpp"
 
-extern int CurTok;
-int getNextToken();
+// Precedence and associativity of every binary operator, indexed by its
+// character. A dense table keeps the operator loop free of searches and
+// allocation; user-defined operators are added to a Parser's own copy.
+struct BinopTable {
+    std::array<int8_t, 256> Precedence; // -1 if the character is not an operator
+    std::array<bool, 256> RightAssoc;
+};
 
-std::unique_ptr<FunctionAST> ParseFunction();
+// The built-in operators, generated at compile time
+constexpr BinopTable MakeBuiltinBinops() {
+    BinopTable T{};
+    for (size_t i = 0; i < 256; ++i) {
+        T.Precedence[i] = -1;
+        T.RightAssoc[i] = false;
+    }
+    T.Precedence['<'] = 10;
+    T.Precedence['+'] = 20;
+    T.Precedence['-'] = 20;
+    T.Precedence['*'] = 40;
+    T.Precedence['/'] = 40;
+    return T;
+}
 
-#endif
\ No newline at end of file
+inline constexpr BinopTable BuiltinBinops = MakeBuiltinBinops();
+
+// Highest precedence a user-defined operator may declare
+constexpr int MaxUserPrecedence = 100;
+
+/**
+ * Recursive descent parser over a source buffer. Expressions are parsed with
+ * an explicit operator stack instead, so the nesting depth of parentheses and
+ * operator chains is bounded by memory rather than by the call stack.
+ * All lexer and parser state lives in the instance, so independent
+ * Parsers can run concurrently on different threads.
+ */
+class Parser {
+    BufferLexer Lexer;
+    ASTArena& Arena; // owns AST nodes and identifier names
+    TokenInfo Tok; // current token
+    int CurTok = tok_eof;
+    bool HadError = false;
+    size_t TokenCount = 0;
+
+    // Built-in operators plus those declared so far in this source
+    BinopTable Binops;
+
+public:
+    // Binops: the operators known at the start of Source, e.g. getBinops() of a
+    // Parser that read the definitions before it
+    Parser(std::string_view Source, ASTArena& Arena, const BinopTable& Binops = BuiltinBinops);
+
+    int getCurTok() const { return CurTok; }
+    int getNextToken();
+
+    std::unique_ptr<FunctionAST> ParseFunction();
+
+    // Parse all functions in the input; check hadError() for definitions that failed
+    std::vector<std::unique_ptr<FunctionAST>> ParseTranslationUnit();
+    bool hadError() const { return HadError; }
+
+    // Built-in operators plus the ones declared so far
+    const BinopTable& getBinops() const { return Binops; }
+
+    // Tokens read so far, including the final end of file
+    size_t getTokenCount() const { return TokenCount; }
+
+private:
+    int GetTokenPrecedence();
+    int GetBinopPrecedence(int Op) const {
+        return static_cast<unsigned>(Op) < 256 ? Binops.Precedence[Op] : -1;
+    }
+    bool ParseOperatorDecl(std::string& FuncName);
+
+    ExprPtr ParseExpression();
+    ExprPtr ParsePrimary();
+    ExprPtr ParseNumberExpr();
+    ExprPtr ParseIdentifierExpr();
+    ExprPtr ParseReturnExpr();
+    ExprPtr ParseBlock();
+    ExprPtr ParseBracedBlock();
+    ExprPtr ParseIfExpr();
+    ExprPtr ParseWhileExpr();
+};
+
+#endif
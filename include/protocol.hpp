@@ -0,0 +1,48 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Framing for the compile server (--server) and its client.
+ *
+ * Every message is one header line of space-separated words followed by a
+ * payload of arbitrary bytes; the last header word is the payload length:
+ *
+ *   obj -O2 -march=native 57\n<57 bytes of source>
+ *   ok 1832\n<1832 bytes of object code>
+ *
+ * Requests:  ir [options] N        -> textual IR
+ *            obj [options] N       -> native object file
+ *            jit [options] N       -> "<handle> <function> <arity>"
+ *            call <handle> args 0  -> the result, printed as text
+ *            release <handle> 0    -> frees the handle's code
+ *            shutdown 0            -> stops the server
+ * Options are the driver's: -O0..-O3, -ffast-math, --batch, --entry F,
+ * -march=native, -mcpu=, -mattr=.
+ * Responses: "ok N" or "error N", the payload being the result or a message.
+ *
+ * A connection can carry any number of requests in sequence.
+ */
+class MessageStream {
+    int FD;
+    std::string Buffer; // bytes read but not yet consumed
+
+    bool fill();
+
+public:
+    explicit MessageStream(int FD) : FD(FD) {}
+
+    // Read one message; returns false on EOF, I/O error or a malformed header
+    bool read(std::vector<std::string>& Header, std::string& Payload);
+
+    // Write one message; Header must not contain newlines. Returns false on error
+    bool write(std::string_view Header, std::string_view Payload);
+};
+
+// Connect to the server listening on the Unix socket at Path; returns -1 on error
+int ConnectUnixSocket(const std::string& Path);
+
+#endif
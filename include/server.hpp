@@ -0,0 +1,85 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "jit.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Long-running compile server behind `my_lang --server SOCKET`.
+ *
+ * Listens on a Unix domain socket and serves the requests described in
+ * protocol.hpp from a fixed pool of worker threads, one connection per
+ * worker at a time. LLVM is initialized once, and a JIT per optimization
+ * level stays warm across requests. Every 'jit' request gets its own JIT
+ * library, so clients can reuse function names; the code lives until the
+ * handle is released.
+ */
+class CompileServer {
+    unsigned Workers;
+    std::string SocketPath;
+    int ListenFD = -1;
+
+    // Accepted connections waiting for a worker, and those being served
+    std::mutex ConnMutex;
+    std::condition_variable ConnReady;
+    std::deque<int> Pending;
+    std::set<int> Active;
+    bool Stopping = false;
+
+    // A JIT shares one TargetMachine between all of its compiles,
+    // so each JIT compiles one request at a time
+    struct WarmJIT {
+        std::mutex Lock;
+        std::unique_ptr<MyLangJIT> JIT;
+    };
+    WarmJIT JITs[3][4]; // by VectorLibrary, then opt level
+
+    // Compiled code behind a 'jit' handle; its library is removed with the
+    // last reference, so a 'release' cannot free code that is being called
+    struct Handle {
+        WarmJIT* Owner;
+        llvm::orc::JITDylib* Lib;
+        void* Addr;
+        unsigned Arity;
+        ~Handle();
+    };
+    std::mutex HandleMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Handle>> Handles;
+    uint64_t NextHandle = 1;
+
+    void workerLoop();
+    void serve(int FD);
+
+    // Handle one request; returns false if Reply is an error message
+    bool handle(const std::vector<std::string>& Header, const std::string& Payload,
+                std::string& Reply);
+    bool compileJIT(const std::vector<std::string>& Header, const std::string& Payload,
+                    std::string& Reply);
+    bool call(const std::vector<std::string>& Header, std::string& Reply);
+    bool release(const std::vector<std::string>& Header, std::string& Reply);
+
+public:
+    // Workers == 0 uses one worker per hardware thread
+    explicit CompileServer(unsigned Workers = 0);
+    ~CompileServer();
+
+    // Bind and listen on Path, replacing a stale socket file; returns false on error
+    bool listen(const std::string& Path);
+
+    // Serve connections until a 'shutdown' request or stop()
+    void run();
+
+    // Stop accepting, close open connections and make run() return
+    void stop();
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "optimizer.hpp"
+#include "stats.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+struct BinopTable;
+
+/**
+ * One independent compilation: source buffer, parser state, AST,
+ * LLVMContext and Module. Sessions share no mutable state, so separate
+ * sessions can lex, parse and generate code on separate threads.
+ *
+ * A source is a translation unit: every 'func' in it is parsed and
+ * generated into the session's single module. With setThreads(N > 1) the
+ * functions are instead split into contiguous shards, each generated and
+ * optimized in its own LLVMContext and module on a work-stealing pool
+ * (see ParallelFor); the shards are linked back in source order when the
+ * module is first asked for, so the output does not depend on scheduling.
+ * Calls between shards are not inlined.
+ */
+class CompilerSession {
+    std::unique_ptr<llvm::MemoryBuffer> SourceBuffer;
+    std::string_view Source;
+
+    // Declared before Functions so the AST is destroyed before the arena it lives in
+    ASTArena Arena;
+    std::vector<std::unique_ptr<FunctionAST>> Functions;
+
+    std::unique_ptr<llvm::LLVMContext> Context;
+    std::unique_ptr<llvm::Module> TheModule;
+
+    // Part of the translation unit generated on its own thread
+    struct ModuleShard {
+        std::unique_ptr<llvm::LLVMContext> Context;
+        std::unique_ptr<llvm::Module> M;
+    };
+    std::vector<ModuleShard> Shards; // not yet linked into TheModule
+    unsigned Threads = 1;
+
+    bool FastMath = false;
+    CompileStats* Stats = nullptr;
+    BinopTable* Operators = nullptr;
+
+    bool codegenShards(bool WithBatchKernel);
+    void linkShards();
+
+public:
+    // UseArena == false allocates AST nodes individually on the heap
+    explicit CompilerSession(bool UseArena = true);
+
+    // Read the source from a file ("-" for standard input); returns false on error
+    bool loadFile(const std::string& Path);
+
+    // Use Text as the source; the caller keeps it alive for the session's lifetime
+    void setSource(std::string_view Text) { Source = Text; }
+
+    // Parse every function in the source; returns false if any definition failed
+    bool parse();
+
+    // Parse with the operators in *Table, e.g. those declared by earlier parts of a
+    // stream, and store them back with the ones this source declares (nullptr: built-ins)
+    void setOperators(BinopTable* Table) { Operators = Table; }
+
+    // Allow algebraic rewrites that ignore signed zeros, infinities and NaN,
+    // both in simplify() and as LLVM fast-math flags in codegen()
+    void setFastMath(bool Enable) { FastMath = Enable; }
+
+    // Record phase times and counters of this session's compile into S (nullptr: off)
+    void setStats(CompileStats* S) { Stats = S; }
+
+    // Fold constants and apply algebraic identities to every parsed function (see ASTSimplifier)
+    void simplify();
+
+    // Generate and optimize on up to N threads (default 1); call before codegen()
+    void setThreads(unsigned N) { Threads = N; }
+
+    // Generate all parsed functions (and optionally their batch kernels) into the module;
+    // returns false on error
+    bool codegen(bool WithBatchKernel = false);
+
+    // Set the module's triple and data layout for TM; call before codegen()
+    void setTarget(const llvm::TargetMachine& TM);
+
+    // Run the optimization pipeline for OptLevel (0-3) over the generated module,
+    // vectorizing math builtins into calls to VecLib if one is given
+    void optimize(unsigned OptLevel, llvm::TargetMachine* TM,
+                  VectorLibrary VecLib = VectorLibrary::None);
+
+    // Hand the module and its context over, e.g. to MyLangJIT::addModule
+    llvm::orc::ThreadSafeModule takeModule();
+
+    // Hand the module over as it was generated: one module per shard, each with
+    // its own context, so a JIT can compile them concurrently; one module otherwise
+    std::vector<llvm::orc::ThreadSafeModule> takeModules();
+
+    std::string_view getSource() const { return Source; }
+    const std::vector<std::unique_ptr<FunctionAST>>& getFunctions() const { return Functions; }
+    ASTArena& getArena() { return Arena; }
+    llvm::Module& getModule() {
+        linkShards();
+        return *TheModule;
+    }
+    llvm::LLVMContext& getContext() { return *Context; }
+};
+
+#endif
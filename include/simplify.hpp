@@ -0,0 +1,57 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include "arena.hpp"
+#include "ast.hpp"
+
+/**
+ * AST-level simplification run before code generation.
+ *
+ * Always (IEEE-exact): folds constant subtrees and removes x*1, 1*x, x/1, x-0.
+ * With FastMath: also x+0, 0+x, x-x, x*0, 0*x, and reassociates chains of
+ * constants, e.g. (x + 2) + 3 -> x + 5 and 2 * (x * 4) -> x * 8.
+ * if/while with a constant condition are reduced to the branch taken; names
+ * assigned only in the dropped code stay declared, so reading them yields 0.0
+ * as it would have before.
+ *
+ * Works on the AST, so every backend (including the textual one) benefits.
+ */
+class ASTSimplifier : public CodegenVisitor {
+    ASTArena* Arena; // where new nodes go; nullptr = heap
+    bool FastMath;
+    FunctionAST* Function = nullptr; // being simplified
+
+    // Node that should replace the one just visited (null = keep it)
+    ExprPtr Replacement;
+
+    // Simplify the subtree in Slot, replacing it in place
+    void simplify(ExprPtr& Slot);
+
+    ExprPtr makeNumber(double Val);
+
+    // Keep the names assigned in a subtree that is about to be dropped declared
+    void keepLocals(ExprAST* Dropped);
+
+    // Fold one operator whose operands are already simplified; sets Replacement
+    void foldBinary(BinaryExprAST* expr);
+
+public:
+    explicit ASTSimplifier(ASTArena* Arena = nullptr, bool FastMath = false)
+        : Arena(Arena), FastMath(FastMath) {}
+
+    void visit(NumberExprAST* expr) override;
+    void visit(VariableExprAST* expr) override;
+    void visit(BinaryExprAST* expr) override;
+    void visit(ReturnExprAST* expr) override;
+    void visit(BlockExprAST* expr) override;
+    void visit(IfExprAST* expr) override;
+    void visit(WhileExprAST* expr) override;
+    void visit(AssignExprAST* expr) override;
+    void visit(CallExprAST* expr) override;
+    void visit(FunctionAST* func) override;
+};
+
+// Simplify func's body in place
+void SimplifyFunction(FunctionAST* func, ASTArena* Arena, bool FastMath);
+
+#endif
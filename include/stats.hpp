@@ -0,0 +1,75 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstdint>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * Instrumentation for --time-report and --stats: time spent per compile
+ * phase plus size counters. Each CompilerSession fills its own instance,
+ * so parallel compiles do not contend; the driver merges them at the end.
+ *
+ * Phase times are llvm::TimeRecords, so the report is printed by an
+ * llvm::TimerGroup in the same layout as LLVM's -time-passes. User and
+ * system times come from getrusage and cover the whole process, so with
+ * -j N they include the other threads; wall times are per phase.
+ */
+struct CompileStats {
+    // Phase name -> accumulated time, e.g. "parse", "codegen", "optimize"
+    llvm::StringMap<llvm::TimeRecord> Phases;
+
+    uint64_t Tokens = 0;
+    uint64_t ASTNodes = 0;
+    uint64_t ASTBytes = 0; // arena bytes: nodes and interned names
+    uint64_t Functions = 0;
+    uint64_t IRInstructions = 0; // as generated, before optimization
+
+    // Add Other's times and counters to this one
+    void merge(const CompileStats& Other);
+};
+
+// Adds the time spent in its scope to Stats->Phases[Name]; does nothing if Stats is null
+class PhaseTimer {
+    CompileStats* Stats;
+    const char* Name;
+    llvm::TimeRecord Start;
+
+public:
+    PhaseTimer(CompileStats* Stats, const char* Name) : Stats(Stats), Name(Name) {
+        if (Stats)
+            Start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+    }
+    ~PhaseTimer() {
+        if (!Stats)
+            return;
+        llvm::TimeRecord Elapsed = llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+        Elapsed -= Start;
+        Stats->Phases[Name] += Elapsed;
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+// Number of instructions in all function bodies of M
+uint64_t CountInstructions(const llvm::Module& M);
+
+// Largest resident set size the process has reached, in bytes (0 if unknown)
+uint64_t GetPeakRSS();
+
+// Print the phase times as an llvm::TimerGroup report
+void PrintTimeReport(const CompileStats& Stats, llvm::raw_ostream& OS);
+
+// Print the counters and peak RSS, one per line
+void PrintStats(const CompileStats& Stats, llvm::raw_ostream& OS);
+
+// Print {"time": {...}, "stats": {...}} with the sections that are enabled.
+// Times are in seconds, sizes in bytes; the keys are stable for CI tooling.
+void PrintStatsJSON(const CompileStats& Stats, bool WithTimes, bool WithCounters,
+                    llvm::raw_ostream& OS);
+
+#endif
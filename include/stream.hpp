@@ -0,0 +1,41 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include "optimizer.hpp"
+#include "stats.hpp"
+#include <cstddef>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+// How CompileStream builds each definition
+struct StreamOptions {
+    unsigned OptLevel = 0;
+    bool FastMath = false;
+    bool WithBatchKernel = false;
+    VectorLibrary VecLib = VectorLibrary::None;
+    llvm::TargetMachine* TM = nullptr; // target of the output; may be nullptr at -O0
+    size_t QueueDepth = 16;            // definitions waiting between two stages
+    CompileStats* Stats = nullptr;     // phase times and counters of all definitions
+};
+
+/**
+ * Compile a source of any size one definition at a time and write LLVM IR
+ * to OS as each is done, as a separate module per definition.
+ *
+ * Three stages run on their own threads, joined by BoundedQueues: reading
+ * and splitting the input (DefinitionSplitter), parsing and simplifying in a
+ * fresh CompilerSession, and code generation, optimization and printing.
+ * So definition N is printed and its AST, arena and module freed while N+1
+ * is parsed and N+2 read, and memory use depends on the queue depth and the
+ * largest definition rather than on the input size.
+ *
+ * Operators declared by a definition apply to the ones after it. Calls to
+ * other definitions become declarations and are not inlined. Path "-" reads
+ * standard input. Returns false if the input could not be read or any
+ * definition failed; the others are still written.
+ */
+bool CompileStream(const std::string& Path, const StreamOptions& Opts, llvm::raw_ostream& OS);
+
+#endif
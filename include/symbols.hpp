@@ -0,0 +1,52 @@
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "llvm/Support/Allocator.h"
+
+// Dense identifier number: the n-th distinct name interned in a SymbolTable is n - 1
+using SymbolID = uint32_t;
+
+/**
+ * Interns identifiers as dense 32-bit SymbolIDs. The AST refers to names by
+ * ID only, so passes compare and index integers (e.g. a flat vector of
+ * values per ID in codegen) and only turn an ID back into text for output.
+ *
+ * Lookup is an open-addressing hash table with linear probing over a flat
+ * array of IDs, kept at most half full; each ID's hash is stored so probes
+ * rarely touch the name itself. Name bytes live in a bump allocator and stay
+ * valid, like the IDs, for the table's lifetime.
+ */
+class SymbolTable {
+    llvm::BumpPtrAllocator Storage; // name bytes
+    std::vector<std::string_view> Names; // by ID
+    std::vector<uint32_t> Hashes;        // by ID
+    std::vector<SymbolID> Slots;         // power-of-two sized; EmptySlot when free
+
+    static constexpr SymbolID EmptySlot = ~SymbolID(0);
+
+    void grow();
+
+public:
+    SymbolTable() : Slots(64, EmptySlot) {}
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // The ID of Name, adding it if it is new
+    SymbolID intern(std::string_view Name);
+
+    std::string_view name(SymbolID ID) const { return Names[ID]; }
+
+    // Symbols interned so far; valid IDs are 0 .. size() - 1
+    size_t size() const { return Names.size(); }
+
+    // Bytes held for names and lookup tables
+    size_t getBytesAllocated() const;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TARGET_HPP
+#define TARGET_HPP
+
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+// Which CPU generated code is tuned and specialized for
+struct TargetSelection {
+    std::string CPU = "generic"; // "native" selects the host CPU and all of its features
+    std::string Features;        // extra -mattr style features, e.g. "+avx2,+fma"
+};
+
+// Create a TargetMachine for the host triple; returns nullptr on error.
+// Code is position independent so objects can be linked into shared libraries.
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(const TargetSelection& Target,
+                                                         unsigned OptLevel);
+
+// A new TargetMachine with the same target, CPU, features and options as TM.
+// TargetMachines are not thread-safe, so each thread that optimizes or emits
+// code concurrently needs its own.
+std::unique_ptr<llvm::TargetMachine> CloneTargetMachine(const llvm::TargetMachine& TM);
+
+// Lower Module to a native object file in memory; returns false on error.
+// The module's triple and data layout must already match TM (CompilerSession::setTarget).
+bool EmitObject(llvm::Module& Module, llvm::TargetMachine& TM, llvm::SmallVectorImpl<char>& Object);
+
+// Lower Module to a native object file at Path; returns false on error
+bool EmitObjectFile(llvm::Module& Module, llvm::TargetMachine& TM, const std::string& Path);
+
+// Link Module into a shared library at Path with the system C compiler driver,
+// against libm and ExtraLib if given (e.g. "mvec" for -lmvec); returns false on error
+bool EmitSharedLibrary(llvm::Module& Module, llvm::TargetMachine& TM, const std::string& Path,
+                       llvm::StringRef ExtraLib = "");
+
+// Write already emitted object code (e.g. from CodeCache) to Path; returns false on error
+bool WriteObjectFile(llvm::StringRef Object, const std::string& Path);
+
+// Link already emitted object code into a shared library at Path; returns false on error
+bool LinkSharedLibrary(llvm::StringRef Object, const std::string& Path,
+                       llvm::StringRef ExtraLib = "");
+
+#endif
@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+# Load test for the compile server: requests per second of my_lang --server
+# (driven by my_lang_client) against running the one-shot my_lang binary.
+#
+# Usage: scripts/server_loadtest.sh [build-dir] [clients] [requests-per-client] [mode]
+#   mode: ir (default) or jit
+
+set -euo pipefail
+
+BUILD=${1:-build}
+CLIENTS=${2:-8}
+REQUESTS=${3:-200}
+MODE=${4:-ir}
+
+MY_LANG="$BUILD/my_lang"
+CLIENT="$BUILD/my_lang_client"
+WORK=$(mktemp -d)
+SOCKET="$WORK/my_lang.sock"
+SOURCE="$WORK/calc.src"
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$SOURCE" <<'SRC'
+func scale(x, y) { return x * 1.5 + y / 2.25; }
+func calculate(x, y) { return (x * 1.5 + y) * (x - y) / (y + 2.0); }
+SRC
+
+if [ "$MODE" = jit ]; then
+    ONE_SHOT=(--jit "$SOURCE" 3 4)
+    REQUEST=(--jit "$SOURCE" 3 4)
+else
+    ONE_SHOT=(-O2 "$SOURCE")
+    REQUEST=(--ir -O2 "$SOURCE")
+fi
+
+now() { date +%s.%N; }
+rate() { awk -v n="$1" -v s="$2" -v e="$3" 'BEGIN { printf "%8.1f req/s  (%d requests, %.2f s)\n", n / (e - s), n, e - s }'; }
+
+TOTAL=$((CLIENTS * REQUESTS))
+
+# One-shot: every request is a fresh process, $CLIENTS at a time
+START=$(now)
+seq "$TOTAL" | xargs -P "$CLIENTS" -I{} "$MY_LANG" "${ONE_SHOT[@]}" >/dev/null 2>&1
+END=$(now)
+printf "one-shot my_lang: "
+rate "$TOTAL" "$START" "$END"
+
+# Server: $CLIENTS persistent connections, $REQUESTS requests each
+"$MY_LANG" --server "$SOCKET" -j "$CLIENTS" 2>/dev/null &
+SERVER=$!
+for _ in $(seq 50); do [ -S "$SOCKET" ] && break; sleep 0.1; done
+
+START=$(now)
+for _ in $(seq "$CLIENTS"); do
+    "$CLIENT" "$SOCKET" "${REQUEST[@]}" --repeat "$REQUESTS" >/dev/null 2>&1 &
+done
+wait $(jobs -p | grep -v "^$SERVER\$")
+END=$(now)
+printf "server:           "
+rate "$TOTAL" "$START" "$END"
+
+"$CLIENT" "$SOCKET" --shutdown
+wait "$SERVER"
@@ -1,4 +1,125 @@
 #include "ast.hpp"
+#include <algorithm>
+
+BinaryExprAST::~BinaryExprAST() {
+    // Only trees with nested operators need the explicit stack
+    if (!AsBinary(LHS.get()) && !AsBinary(RHS.get()))
+        return;
+
+    // Detach the operands of every nested operator before it is destroyed, so
+    // each destructor below sees leaf operands and returns without recursing
+    llvm::SmallVector<ExprPtr, 16> Pending;
+    Pending.push_back(std::move(LHS));
+    Pending.push_back(std::move(RHS));
+    while (!Pending.empty()) {
+        ExprPtr Node = Pending.pop_back_val();
+        if (BinaryExprAST* B = AsBinary(Node.get())) {
+            Pending.push_back(std::move(B->LHS));
+            Pending.push_back(std::move(B->RHS));
+        }
+    }
+}
+
+namespace {
+// Appends the names assigned in a subtree that Names does not hold yet, in first-assignment order
+class AssignedNameCollector : public CodegenVisitor {
+public:
+    std::vector<SymbolID>& Names;
+
+    explicit AssignedNameCollector(std::vector<SymbolID>& Names) : Names(Names) {}
+
+    void visit(NumberExprAST*) override {}
+    void visit(VariableExprAST*) override {}
+    void visit(BinaryExprAST* expr) override {
+        WalkBinaryTree(
+            expr,
+            [&](ExprPtr& Operand) {
+                Operand->accept(*this);
+                return true;
+            },
+            [](BinaryExprAST*, ExprPtr*) { return true; });
+    }
+    void visit(ReturnExprAST* expr) override { expr->getExpr()->accept(*this); }
+    void visit(BlockExprAST* expr) override {
+        for (const auto& expression : expr->getExpressions())
+            expression->accept(*this);
+    }
+    void visit(IfExprAST* expr) override {
+        expr->getCond()->accept(*this);
+        expr->getThen()->accept(*this);
+        if (expr->getElse())
+            expr->getElse()->accept(*this);
+    }
+    void visit(WhileExprAST* expr) override {
+        expr->getCond()->accept(*this);
+        expr->getBody()->accept(*this);
+    }
+    void visit(AssignExprAST* expr) override {
+        expr->getValue()->accept(*this);
+        if (std::find(Names.begin(), Names.end(), expr->getName()) == Names.end())
+            Names.push_back(expr->getName());
+    }
+    void visit(CallExprAST* expr) override {
+        for (const auto& Arg : expr->getArgs())
+            Arg->accept(*this);
+    }
+    void visit(FunctionAST* func) override { func->getBody()->accept(*this); }
+};
+} // namespace
+
+void CollectAssignedNames(ExprAST* E, std::vector<SymbolID>& Names) {
+    AssignedNameCollector Collector(Names);
+    E->accept(Collector);
+}
+
+namespace {
+// Appends every call in a subtree, each before the calls in its arguments
+class CallCollector : public CodegenVisitor {
+public:
+    std::vector<CallExprAST*>& Calls;
+
+    explicit CallCollector(std::vector<CallExprAST*>& Calls) : Calls(Calls) {}
+
+    void visit(NumberExprAST*) override {}
+    void visit(VariableExprAST*) override {}
+    void visit(BinaryExprAST* expr) override {
+        WalkBinaryTree(
+            expr,
+            [&](ExprPtr& Operand) {
+                Operand->accept(*this);
+                return true;
+            },
+            [](BinaryExprAST*, ExprPtr*) { return true; });
+    }
+    void visit(ReturnExprAST* expr) override { expr->getExpr()->accept(*this); }
+    void visit(BlockExprAST* expr) override {
+        for (const auto& expression : expr->getExpressions())
+            expression->accept(*this);
+    }
+    void visit(IfExprAST* expr) override {
+        expr->getCond()->accept(*this);
+        expr->getThen()->accept(*this);
+        if (expr->getElse())
+            expr->getElse()->accept(*this);
+    }
+    void visit(WhileExprAST* expr) override {
+        expr->getCond()->accept(*this);
+        expr->getBody()->accept(*this);
+    }
+    void visit(AssignExprAST* expr) override { expr->getValue()->accept(*this); }
+    void visit(CallExprAST* expr) override {
+        Calls.push_back(expr);
+        for (const auto& Arg : expr->getArgs())
+            Arg->accept(*this);
+    }
+    void visit(FunctionAST* func) override { func->getBody()->accept(*this); }
+};
+} // namespace
+
+void CollectCalls(ExprAST* E, std::vector<CallExprAST*>& Calls) {
+    CallCollector Collector(Calls);
+    E->accept(Collector);
+}
 
 // Implementation of accept methods for the visitor pattern
 
@@ -22,6 +143,22 @@ void BlockExprAST::accept(CodegenVisitor& visitor) {
     visitor.visit(this);
 }
 
+void IfExprAST::accept(CodegenVisitor& visitor) {
+    visitor.visit(this);
+}
+
+void WhileExprAST::accept(CodegenVisitor& visitor) {
+    visitor.visit(this);
+}
+
+void AssignExprAST::accept(CodegenVisitor& visitor) {
+    visitor.visit(this);
+}
+
+void CallExprAST::accept(CodegenVisitor& visitor) {
+    visitor.visit(this);
+}
+
 void FunctionAST::accept(CodegenVisitor& visitor) {
     visitor.visit(this);
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "cache.hpp"
+#include "lexer.hpp"
+#include <algorithm>
+#include <iostream>
+#include <tuple>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Bump when the entry format or anything else hashed implicitly changes
+static constexpr const char* CacheFormat = "my_lang-object-v1";
+
+std::string CodeCache::entryPath(const std::string& Key) const {
+    llvm::SmallString<256> Path(Dir);
+    llvm::sys::path::append(Path, Key + ".obj");
+    return Path.str().str();
+}
+
+bool CodeCache::init() {
+    if (std::error_code EC = llvm::sys::fs::create_directories(Dir)) {
+        std::cerr << "Cannot create cache directory " << Dir << ": " << EC.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CodeCache::lookup(const std::string& Key) {
+    std::string Path = entryPath(Key);
+    auto Buffer = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+        ++Misses;
+        return nullptr;
+    }
+    ++Hits;
+
+    // Touch the entry so eviction sees it as recently used
+    int FD;
+    if (!llvm::sys::fs::openFileForWrite(Path, FD, llvm::sys::fs::CD_OpenExisting,
+                                         llvm::sys::fs::OF_Append)) {
+        llvm::sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+        llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+    }
+    return std::move(*Buffer);
+}
+
+bool CodeCache::store(const std::string& Key, llvm::StringRef Data) {
+    llvm::SmallString<256> Model(Dir);
+    llvm::sys::path::append(Model, "tmp-%%%%%%%%.partial");
+
+    int FD;
+    llvm::SmallString<256> TempPath;
+    if (std::error_code EC = llvm::sys::fs::createUniqueFile(Model, FD, TempPath)) {
+        std::cerr << "Cannot write cache entry: " << EC.message() << "\n";
+        return false;
+    }
+
+    {
+        llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        OS << Data;
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            llvm::sys::fs::remove(TempPath);
+            std::cerr << "Cannot write cache entry " << TempPath.str().str() << "\n";
+            return false;
+        }
+    }
+
+    if (std::error_code EC = llvm::sys::fs::rename(TempPath, entryPath(Key))) {
+        llvm::sys::fs::remove(TempPath);
+        std::cerr << "Cannot write cache entry: " << EC.message() << "\n";
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+namespace {
+struct EntryInfo {
+    std::string Path;
+    uint64_t Size;
+    llvm::sys::TimePoint<> LastUsed;
+};
+} // namespace
+
+static std::vector<EntryInfo> ListEntries(const std::string& Dir) {
+    std::vector<EntryInfo> Entries;
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC; It.increment(EC)) {
+        if (llvm::sys::path::extension(It->path()) != ".obj")
+            continue;
+        llvm::sys::fs::file_status Status;
+        if (llvm::sys::fs::status(It->path(), Status))
+            continue;
+        Entries.push_back({It->path(), Status.getSize(), Status.getLastModificationTime()});
+    }
+    return Entries;
+}
+
+void CodeCache::evict() {
+    std::lock_guard<std::mutex> Lock(EvictMutex);
+
+    std::vector<EntryInfo> Entries = ListEntries(Dir);
+    uint64_t Total = 0;
+    for (const auto& E : Entries)
+        Total += E.Size;
+    if (Total <= MaxBytes)
+        return;
+
+    std::sort(Entries.begin(), Entries.end(),
+              [](const EntryInfo& A, const EntryInfo& B) { return A.LastUsed < B.LastUsed; });
+    for (const auto& E : Entries) {
+        if (Total <= MaxBytes)
+            break;
+        if (!llvm::sys::fs::remove(E.Path))
+            Total -= E.Size;
+    }
+}
+
+std::pair<size_t, uint64_t> CodeCache::getUsage() const {
+    std::vector<EntryInfo> Entries = ListEntries(Dir);
+    uint64_t Total = 0;
+    for (const auto& E : Entries)
+        Total += E.Size;
+    return {Entries.size(), Total};
+}
+
+std::string ComputeCacheKey(std::string_view Source, const llvm::TargetMachine& TM,
+                            unsigned OptLevel, bool FastMath, bool WithBatchKernel,
+                            VectorLibrary VecLib) {
+    llvm::SHA1 Hasher;
+    auto AddField = [&](llvm::StringRef Field) {
+        uint32_t Len = static_cast<uint32_t>(Field.size());
+        Hasher.update(llvm::StringRef(reinterpret_cast<const char*>(&Len), sizeof(Len)));
+        Hasher.update(Field);
+    };
+
+    AddField(CacheFormat);
+    AddField(LLVM_VERSION_STRING);
+    AddField(TM.getTargetTriple().str());
+    AddField(TM.getTargetCPU());
+    AddField(TM.getTargetFeatureString());
+    AddField(std::to_string(OptLevel));
+    AddField(FastMath ? "fast-math" : "");
+    AddField(WithBatchKernel ? "batch" : "");
+    AddField(VectorLibraryName(VecLib));
+
+    BufferLexer Lexer(Source);
+    for (TokenInfo Tok = Lexer.next(); Tok.Kind != tok_eof; Tok = Lexer.next()) {
+        Hasher.update(llvm::StringRef(reinterpret_cast<const char*>(&Tok.Kind), sizeof(Tok.Kind)));
+        if (Tok.Kind == tok_identifier)
+            AddField(llvm::StringRef(Tok.Text.data(), Tok.Text.size()));
+        else if (Tok.Kind == tok_number)
+            Hasher.update(llvm::StringRef(reinterpret_cast<const char*>(&Tok.NumVal), sizeof(Tok.NumVal)));
+    }
+
+    auto Digest = Hasher.final();
+    return llvm::toHex(llvm::ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(Digest.data()),
+                                               Digest.size()),
+                       /*LowerCase=*/true);
+}
+
+std::string CachedObject::serialize() const {
+    std::string Data = CacheFormat;
+    Data += "\n" + std::to_string(Functions.size()) + "\n";
+    for (const auto& [Name, Arity] : Functions)
+        Data += Name + " " + std::to_string(Arity) + "\n";
+    Data += Object;
+    return Data;
+}
+
+bool CachedObject::deserialize(llvm::StringRef Data) {
+    auto NextLine = [&](llvm::StringRef& Line) {
+        size_t EOL = Data.find('\n');
+        if (EOL == llvm::StringRef::npos)
+            return false;
+        Line = Data.take_front(EOL);
+        Data = Data.drop_front(EOL + 1);
+        return true;
+    };
+
+    llvm::StringRef Line;
+    size_t Count;
+    if (!NextLine(Line) || Line != CacheFormat || !NextLine(Line) || Line.getAsInteger(10, Count))
+        return false;
+
+    Functions.clear();
+    for (size_t i = 0; i < Count; ++i) {
+        llvm::StringRef Name, ArityText;
+        unsigned Arity;
+        if (!NextLine(Line))
+            return false;
+        std::tie(Name, ArityText) = Line.split(' ');
+        if (Name.empty() || ArityText.getAsInteger(10, Arity))
+            return false;
+        Functions.emplace_back(Name.str(), Arity);
+    }
+
+    Object = Data.str();
+    return true;
+}
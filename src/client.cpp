@@ -0,0 +1,161 @@
+// Command-line client for the compile server (my_lang --server SOCKET).
+//
+// Sends one source file and prints the IR, writes the object file, or
+// JIT-compiles it in the server and prints the result of calling it.
+// With --repeat N the exchange is repeated over one connection and the
+// request rate is reported on stderr (see scripts/server_loadtest.sh).
+
+#include "protocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static void PrintUsage(const char* Argv0) {
+    std::cerr << "Usage: " << Argv0 << " SOCKET [mode] [options] [source-file] [call-args...]\n"
+              << "Reads standard input when no source file is given.\n"
+              << "Numbers after the source file, or after '--', are call-args for --jit.\n"
+              << "Modes:\n"
+              << "  --ir        Print the module's IR (default)\n"
+              << "  --obj FILE  Write a native object file\n"
+              << "  --jit       Compile in the server and call a function with call-args\n"
+              << "  --shutdown  Stop the server\n"
+              << "Options:\n"
+              << "  -O0 .. -O3, -ffast-math, --veclib=L, --batch, --entry F, -march=native,\n"
+              << "  -mcpu=CPU, -mattr=F  Passed to the server, as for my_lang\n"
+              << "  --repeat N  Send the request N times and report requests per second\n";
+}
+
+static bool ReadSource(const std::string& Path, std::string& Source) {
+    if (Path == "-") {
+        Source.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        return true;
+    }
+    std::ifstream In(Path, std::ios::binary);
+    if (!In) {
+        std::cerr << "Cannot open " << Path << "\n";
+        return false;
+    }
+    Source.assign(std::istreambuf_iterator<char>(In), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Send one request and wait for its response; returns false on an error response
+static bool Exchange(MessageStream& Stream, const std::string& Header, const std::string& Payload,
+                     std::string& Reply) {
+    std::vector<std::string> Response;
+    if (!Stream.write(Header, Payload) || !Stream.read(Response, Reply) || Response.empty()) {
+        std::cerr << "Connection to server lost\n";
+        std::exit(1);
+    }
+    if (Response[0] != "ok") {
+        std::cerr << "Server error: " << Reply << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    std::string SocketPath = argv[1];
+
+    std::string Mode = "ir", ObjectPath, Options, Input, CallArgs;
+    long Repeat = 1;
+    bool OnlyCallArgs = false; // after "--"
+    for (int i = 2; i < argc; ++i) {
+        std::string Arg = argv[i];
+        char* End = nullptr;
+        std::strtod(Arg.c_str(), &End);
+        bool IsNumber = !Arg.empty() && *End == '\0';
+
+        // As for my_lang: numbers are call arguments after the source file or "--"
+        if (OnlyCallArgs || (IsNumber && !Input.empty())) {
+            if (!IsNumber) {
+                std::cerr << "Call argument is not a number: " << Arg << "\n";
+                return 1;
+            }
+            CallArgs += " " + Arg;
+            continue;
+        }
+
+        if (Arg == "--") {
+            OnlyCallArgs = true;
+        } else if (Arg == "--ir" || Arg == "--jit" || Arg == "--shutdown") {
+            Mode = Arg.substr(2);
+        } else if (Arg == "--obj" && i + 1 < argc) {
+            Mode = "obj";
+            ObjectPath = argv[++i];
+        } else if (Arg == "--repeat" && i + 1 < argc) {
+            Repeat = std::max(1L, std::atol(argv[++i]));
+        } else if (Arg == "--entry" && i + 1 < argc) {
+            Options += " --entry " + std::string(argv[++i]);
+        } else if (Arg == "--help" || Arg == "-h") {
+            PrintUsage(argv[0]);
+            return 0;
+        } else if (Arg[0] == '-' && Arg != "-" && !IsNumber) {
+            Options += " " + Arg;
+        } else {
+            Input = Arg;
+        }
+    }
+
+    if (!CallArgs.empty() && Mode != "jit") {
+        std::cerr << "Call arguments are only used with --jit\n";
+        return 1;
+    }
+
+    int FD = ConnectUnixSocket(SocketPath);
+    if (FD < 0)
+        return 1;
+    MessageStream Stream(FD);
+    std::string Reply;
+
+    if (Mode == "shutdown")
+        return Exchange(Stream, "shutdown", "", Reply) ? 0 : 1;
+
+    std::string Source;
+    if (!ReadSource(Input.empty() ? "-" : Input, Source))
+        return 1;
+
+    auto Start = std::chrono::steady_clock::now();
+    for (long i = 0; i < Repeat; ++i) {
+        if (!Exchange(Stream, Mode + Options, Source, Reply))
+            return 1;
+
+        if (Mode == "jit") {
+            // Reply is "<handle> <function> <arity>"
+            std::string Handle = Reply.substr(0, Reply.find(' '));
+            if (!Exchange(Stream, "call " + Handle + CallArgs, "", Reply))
+                return 1;
+            std::string Result = Reply;
+            Exchange(Stream, "release " + Handle, "", Reply);
+            Reply = Result + "\n";
+        }
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+    if (Mode == "obj") {
+        std::ofstream Out(ObjectPath, std::ios::binary);
+        if (!Out.write(Reply.data(), Reply.size())) {
+            std::cerr << "Cannot write " << ObjectPath << "\n";
+            return 1;
+        }
+    } else {
+        std::cout << Reply;
+    }
+
+    if (Repeat > 1)
+        std::cerr << Repeat << " requests in " << Elapsed.count() << " s ("
+                  << Repeat / Elapsed.count() << " req/s)\n";
+    ::close(FD);
+    return 0;
+}
@@ -1,71 +1,158 @@
 #include "codegen.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+
+std::vector<SymbolID> CollectAssignedNames(FunctionAST* func) {
+    std::vector<SymbolID> Names;
+    CollectAssignedNames(func->getBody(), Names);
+    for (SymbolID Local : func->getDeclaredLocals())
+        if (std::find(Names.begin(), Names.end(), Local) == Names.end())
+            Names.push_back(Local);
+    return Names;
+}
+
+static bool IsArgument(FunctionAST* func, SymbolID Name) {
+    const auto& Args = func->getArgs();
+    return std::find(Args.begin(), Args.end(), Name) != Args.end();
+}
+
+static const MathBuiltin MathBuiltins[] = {
+    {"sqrt", llvm::Intrinsic::sqrt, 1},
+    {"exp", llvm::Intrinsic::exp, 1},
+    {"log", llvm::Intrinsic::log, 1},
+    {"pow", llvm::Intrinsic::pow, 2},
+    {"sin", llvm::Intrinsic::sin, 1},
+    {"cos", llvm::Intrinsic::cos, 1},
+    {"fma", llvm::Intrinsic::fma, 3},
+    {"abs", llvm::Intrinsic::fabs, 1},
+    {"min", llvm::Intrinsic::minnum, 2},
+    {"max", llvm::Intrinsic::maxnum, 2},
+};
+
+const MathBuiltin* FindMathBuiltin(std::string_view Name) {
+    for (const MathBuiltin& B : MathBuiltins)
+        if (Name == B.Name)
+            return &B;
+    return nullptr;
+}
+
+// Reference to a global in textual IR; names that are not plain identifiers,
+// such as "binary%", must be quoted
+static std::string GlobalRef(const std::string& Name) {
+    for (char C : Name)
+        if (!std::isalnum(static_cast<unsigned char>(C)) && C != '_' && C != '.' && C != '$')
+            return "@\"" + Name + "\"";
+    return "@" + Name;
+}
+
+// Format a double as an LLVM IR hex constant, which is exact for every value
+static std::string FormatDouble(double Val) {
+    uint64_t Bits;
+    std::memcpy(&Bits, &Val, sizeof(Bits));
+    char Buf[32];
+    std::snprintf(Buf, sizeof(Buf), "0x%016llX", static_cast<unsigned long long>(Bits));
+    return Buf;
+}
+
 void LLVMIRGenerator::visit(NumberExprAST* expr) {
-    // Store the number in a temporary variable - corrected to use LLVM IR's proper syntax
-    std::string tempVar = getNextTempVar();
-    Output += tempVar + " = fadd double 0.0, " + std::to_string(expr->getValue()) + "\n";
+    // Constants are used directly as operands, so they cost no instruction
+    LastValue = FormatDouble(expr->getValue());
 }
 
 void LLVMIRGenerator::visit(VariableExprAST* expr) {
-    // Load the variable from memory - with proper type information
+    std::string Name(Symbols->name(expr->getName()));
+
+    // Arguments that are never assigned are used directly
+    if (!MutableVars.count(expr->getName())) {
+        LastValue = "%" + Name;
+        return;
+    }
+
+    // Mutable variables live in their stack slot
     std::string tempVar = getNextTempVar();
-    Output += tempVar + " = load double, double* %" + expr->getName() + "\n";
+    Out << tempVar << " = load double, double* %" << Name << ".addr\n";
+    LastValue = tempVar;
 }
 
-void LLVMIRGenerator::visit(BinaryExprAST* expr) {
-    // First generate code for the left-hand side
-    expr->getLHS()->accept(*this);
-    std::string lhsVar = "%t" + std::to_string(TempVarCounter - 1);
-    
-    // Then generate code for the right-hand side
-    expr->getRHS()->accept(*this);
-    std::string rhsVar = "%t" + std::to_string(TempVarCounter - 1);
-    
-    // Now generate code for the operation
+bool LLVMIRGenerator::emitBinary(char Op, const std::string& lhsVar, const std::string& rhsVar) {
     std::string tempVar = getNextTempVar();
     
-    switch (expr->getOperator()) {
+    switch (Op) {
         case '+': {
-            Output += tempVar + " = fadd double " + lhsVar + ", " + rhsVar + "\n";
+            Out << tempVar << " = fadd double " << lhsVar << ", " << rhsVar << "\n";
             break;
         }
         case '-': {
-            Output += tempVar + " = fsub double " + lhsVar + ", " + rhsVar + "\n";
+            Out << tempVar << " = fsub double " << lhsVar << ", " << rhsVar << "\n";
             break;
         }
         case '*': {
-            Output += tempVar + " = fmul double " + lhsVar + ", " + rhsVar + "\n";
+            Out << tempVar << " = fmul double " << lhsVar << ", " << rhsVar << "\n";
             break;
         }
         case '/': {
-            Output += tempVar + " = fdiv double " + lhsVar + ", " + rhsVar + "\n";
+            Out << tempVar << " = fdiv double " << lhsVar << ", " << rhsVar << "\n";
             break;
         }
         case '<': {
             // Generate comparison 
             std::string compVar = getNextTempVar();
-            Output += compVar + " = fcmp olt double " + lhsVar + ", " + rhsVar + "\n";
+            Out << compVar << " = fcmp olt double " << lhsVar << ", " << rhsVar << "\n";
             
             // Convert boolean to double (0.0 or 1.0)
-            Output += tempVar + " = uitofp i1 " + compVar + " to double\n";
+            Out << tempVar << " = uitofp i1 " << compVar << " to double\n";
             break;
         }
         default: {
-            std::cerr << "Unknown binary operator: " << expr->getOperator() << "\n";
-            return;
+            // User-defined operators call the function that implements them
+            std::string Callee = OperatorFunctionName(Op);
+            noteCall(Callee, 2);
+            Out << tempVar << " = call double " << GlobalRef(Callee) << "(double "
+                << lhsVar << ", double " << rhsVar << ")\n";
+            break;
         }
     }
+    LastValue = tempVar;
+    return true;
+}
+
+void LLVMIRGenerator::visit(BinaryExprAST* expr) {
+    // Operands are generated left to right onto a stack of operand names
+    std::vector<std::string> Values;
+    WalkBinaryTree(
+        expr,
+        [&](ExprPtr& Operand) {
+            Operand->accept(*this);
+            Values.push_back(LastValue);
+            return true;
+        },
+        [&](BinaryExprAST* Node, ExprPtr*) {
+            std::string rhsVar = std::move(Values.back());
+            Values.pop_back();
+            if (!emitBinary(Node->getOperator(), Values.back(), rhsVar))
+                return false;
+            Values.back() = LastValue;
+            return true;
+        });
 }
 
 void LLVMIRGenerator::visit(ReturnExprAST* expr) {
     // Generate code for the return value
     expr->getExpr()->accept(*this);
-    std::string retVar = "%t" + std::to_string(TempVarCounter - 1);
+    std::string retVar = LastValue;
     
     // Generate return instruction
-    Output += "ret double " + retVar + "\n";
+    Out << "ret double " << retVar << "\n";
     
     // Mark that we've processed a return statement
     setHasReturn(true);
@@ -75,12 +162,8 @@ void LLVMIRGenerator::visit(BlockExprAST* expr) {
     // Visit each expression in the block
     const auto& expressions = expr->getExpressions();
     
-    if (expressions.empty()) {
-        // Handle empty block with proper return type
-        Output += "ret double 0.0\n";
-        setHasReturn(true);
-        return;
-    }
+    // An empty block yields 0.0; a function body without a return gets one from visit(FunctionAST*)
+    LastValue = FormatDouble(0.0);
     
     for (const auto& expression : expressions) {
         expression->accept(*this);
@@ -92,28 +175,120 @@ void LLVMIRGenerator::visit(BlockExprAST* expr) {
     }
 }
 
+void LLVMIRGenerator::visit(IfExprAST* expr) {
+    int Id = LabelCounter++;
+    std::string Then = "then" + std::to_string(Id), Else = "else" + std::to_string(Id),
+                Merge = "ifcont" + std::to_string(Id);
+
+    expr->getCond()->accept(*this);
+    std::string condVar = getNextTempVar();
+    Out << condVar << " = fcmp une double " << LastValue << ", 0x0000000000000000\n";
+    Out << "br i1 " << condVar << ", label %" << Then << ", label %" << Else << "\n";
+
+    // Each branch that falls through to the merge block contributes a phi operand
+    std::string Incoming;
+    auto EmitBranch = [&](const std::string& Label, ExprAST* Body) {
+        emitLabel(Label);
+        setHasReturn(false);
+        LastValue = FormatDouble(0.0);
+        if (Body)
+            Body->accept(*this);
+        if (hasReturn())
+            return;
+        if (!Incoming.empty())
+            Incoming += ", ";
+        Incoming += "[ " + LastValue + ", %" + CurrentBlock + " ]";
+        Out << "br label %" << Merge << "\n";
+    };
+    EmitBranch(Then, expr->getThen());
+    EmitBranch(Else, expr->getElse());
+
+    // Both branches returned: nothing follows the if
+    if (Incoming.empty()) {
+        setHasReturn(true);
+        return;
+    }
+
+    emitLabel(Merge);
+    setHasReturn(false);
+    LastValue = getNextTempVar();
+    Out << LastValue << " = phi double " << Incoming << "\n";
+}
+
+void LLVMIRGenerator::visit(WhileExprAST* expr) {
+    int Id = LabelCounter++;
+    std::string Cond = "loop" + std::to_string(Id), Body = "body" + std::to_string(Id),
+                After = "endloop" + std::to_string(Id);
+
+    Out << "br label %" << Cond << "\n";
+    emitLabel(Cond);
+    expr->getCond()->accept(*this);
+    std::string condVar = getNextTempVar();
+    Out << condVar << " = fcmp une double " << LastValue << ", 0x0000000000000000\n";
+    Out << "br i1 " << condVar << ", label %" << Body << ", label %" << After << "\n";
+
+    emitLabel(Body);
+    expr->getBody()->accept(*this);
+    if (!hasReturn())
+        Out << "br label %" << Cond << "\n";
+
+    emitLabel(After);
+    setHasReturn(false);
+    LastValue = FormatDouble(0.0);
+}
+
+void LLVMIRGenerator::visit(AssignExprAST* expr) {
+    expr->getValue()->accept(*this);
+    Out << "store double " << LastValue << ", double* %" << Symbols->name(expr->getName())
+        << ".addr\n";
+}
+
+void LLVMIRGenerator::visit(CallExprAST* expr) {
+    std::string Args;
+    for (const auto& Arg : expr->getArgs()) {
+        Arg->accept(*this);
+        if (!Args.empty())
+            Args += ", ";
+        Args += "double " + LastValue;
+    }
+
+    std::string Callee(Symbols->name(expr->getCallee()));
+    if (const MathBuiltin* B = FindMathBuiltin(Callee))
+        Callee = llvm::Intrinsic::getBaseName(B->ID).str() + ".f64";
+    noteCall(Callee, expr->getArgs().size());
+
+    std::string tempVar = getNextTempVar();
+    Out << tempVar << " = call double " << GlobalRef(Callee) << "(" << Args << ")\n";
+    LastValue = tempVar;
+}
+
 void LLVMIRGenerator::visit(FunctionAST* func) {
     // Reset return flag
     setHasReturn(false);
+    Symbols = &func->getSymbols();
     
     // Generate function header
-    Output = "define double @" + func->getName() + "(";
+    Out << "define double " << GlobalRef(func->getName()) << "(";
     
     // Add function parameters
     const auto& args = func->getArgs();
     for (size_t i = 0; i < args.size(); ++i) {
-        if (i > 0) Output += ", ";
-        Output += "double %" + args[i];
+        if (i > 0) Out << ", ";
+        Out << "double %" << Symbols->name(args[i]);
     }
-    Output += ") {\n";
+    Out << ") {\n";
     
     // Add entry point label
-    Output += "entry:\n";
+    emitLabel("entry");
     
-    // Allocate memory for function parameters
-    for (const auto& arg : args) {
-        Output += "  %" + arg + ".addr = alloca double\n";
-        Output += "  store double %" + arg + ", double* %" + arg + ".addr\n";
+    // Only assigned names get a stack slot: arguments start with their value, locals with 0.0
+    MutableVars.clear();
+    for (SymbolID Assigned : CollectAssignedNames(func)) {
+        std::string Name(Symbols->name(Assigned));
+        std::string Init = IsArgument(func, Assigned) ? "%" + Name : FormatDouble(0.0);
+        Out << "  %" << Name << ".addr = alloca double\n";
+        Out << "  store double " << Init << ", double* %" << Name << ".addr\n";
+        MutableVars.insert(Assigned);
     }
     
     // Generate code for the function body
@@ -121,22 +296,447 @@ void LLVMIRGenerator::visit(FunctionAST* func) {
     
     // If the function doesn't end with a return statement, add one
     if (!hasReturn()) {
-        Output += "  ret double 0.0\n";
+        Out << "  ret double 0.0\n";
     }
     
     // Close function
-    if (Output.back() != '\n') Output += "\n";
-    Output += "}\n";
+    Out << "}\n";
 }
 
-void GenerateLLVMIR(FunctionAST* func) {
-    std::cout << "Generating LLVM IR...\n";
-    
-    LLVMIRGenerator generator;
-    func->accept(generator);
-    
-    std::cout << "Generated LLVM IR:\n";
-    std::cout << "==================\n";
-    std::cout << generator.getIR();
-    std::cout << "==================\n";
-}
\ No newline at end of file
+void GenerateLLVMIR(const std::vector<std::unique_ptr<FunctionAST>>& Functions,
+                    llvm::raw_ostream& OS) {
+    CalledFunctionMap Called;
+    llvm::StringSet<> Defined;
+    for (const auto& Func : Functions) {
+        LLVMIRGenerator generator(OS, &Called);
+        Func->accept(generator);
+        Defined.insert(Func->getName());
+    }
+
+    // Intrinsics and functions defined outside the unit must be declared
+    for (const auto& [Name, Arity] : Called) {
+        if (Defined.count(Name))
+            continue;
+        OS << "declare double " << GlobalRef(Name) << "(";
+        for (unsigned i = 0; i < Arity; ++i)
+            OS << (i ? ", double" : "double");
+        OS << ")\n";
+    }
+}
+
+// ===== LLVMModuleGenerator =====
+
+void LLVMModuleGenerator::visit(NumberExprAST* expr) {
+    LastValue = llvm::ConstantFP::get(Context, llvm::APFloat(expr->getValue()));
+}
+
+void LLVMModuleGenerator::visit(VariableExprAST* expr) {
+    llvm::Value* V = lookup(expr->getName());
+    std::string_view Name = Symbols->name(expr->getName());
+    if (!V) {
+        std::cerr << "Unknown variable name: " << Name << "\n";
+        LastValue = nullptr;
+        return;
+    }
+
+    // Mutable variables live in a stack slot; everything else is already an SSA value
+    if (auto* Slot = llvm::dyn_cast<llvm::AllocaInst>(V))
+        LastValue = Builder.CreateLoad(Slot->getAllocatedType(), Slot,
+                                       llvm::StringRef(Name.data(), Name.size()));
+    else
+        LastValue = V;
+}
+
+llvm::Value* LLVMModuleGenerator::emitBinary(char Op, llvm::Value* L, llvm::Value* R) {
+    switch (Op) {
+        case '+':
+            return Builder.CreateFAdd(L, R, "addtmp");
+        case '-':
+            return Builder.CreateFSub(L, R, "subtmp");
+        case '*':
+            return Builder.CreateFMul(L, R, "multmp");
+        case '/':
+            return Builder.CreateFDiv(L, R, "divtmp");
+        case '<': {
+            // Compare, then convert the i1 result to double (0.0 or 1.0)
+            llvm::Value* Cmp = Builder.CreateFCmpOLT(L, R, "cmptmp");
+            return Builder.CreateUIToFP(Cmp, llvm::Type::getDoubleTy(Context), "booltmp");
+        }
+        default: {
+            // User-defined operators call the function that implements them; the parser
+            // only accepts operators that were declared, but the definition may not be
+            // in this module
+            std::string Name = OperatorFunctionName(Op);
+            llvm::Function* F = TheModule.getFunction(Name);
+            if (!F) {
+                llvm::Type* DoubleTy = llvm::Type::getDoubleTy(Context);
+                llvm::FunctionType* FT = llvm::FunctionType::get(DoubleTy, {DoubleTy, DoubleTy}, false);
+                F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, TheModule);
+            }
+            return Builder.CreateCall(F, {L, R}, "optmp");
+        }
+    }
+}
+
+void LLVMModuleGenerator::visit(BinaryExprAST* expr) {
+    // Operands are generated left to right onto a value stack
+    llvm::SmallVector<llvm::Value*, 16> Values;
+    bool Ok = WalkBinaryTree(
+        expr,
+        [&](ExprPtr& Operand) {
+            Operand->accept(*this);
+            Values.push_back(LastValue);
+            return LastValue != nullptr;
+        },
+        [&](BinaryExprAST* Node, ExprPtr*) {
+            llvm::Value* R = Values.pop_back_val();
+            Values.back() = emitBinary(Node->getOperator(), Values.back(), R);
+            return Values.back() != nullptr;
+        });
+    LastValue = Ok ? Values.back() : nullptr;
+}
+
+void LLVMModuleGenerator::visit(ReturnExprAST* expr) {
+    expr->getExpr()->accept(*this);
+    if (!LastValue)
+        return;
+
+    Builder.CreateRet(LastValue);
+    HasReturn = true;
+}
+
+void LLVMModuleGenerator::visit(BlockExprAST* expr) {
+    // An empty block still yields a value so callers can check LastValue for errors
+    LastValue = llvm::ConstantFP::get(Context, llvm::APFloat(0.0));
+
+    for (const auto& expression : expr->getExpressions()) {
+        expression->accept(*this);
+        if (!LastValue || HasReturn)
+            return;
+    }
+}
+
+llvm::Value* LLVMModuleGenerator::emitCondition(ExprAST* Cond, const char* Name) {
+    Cond->accept(*this);
+    if (!LastValue)
+        return nullptr;
+    return Builder.CreateFCmpUNE(LastValue, llvm::ConstantFP::get(Context, llvm::APFloat(0.0)), Name);
+}
+
+void LLVMModuleGenerator::visit(IfExprAST* expr) {
+    llvm::Value* Cond = emitCondition(expr->getCond(), "ifcond");
+    if (!Cond)
+        return;
+
+    llvm::Function* F = Builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* ThenBB = llvm::BasicBlock::Create(Context, "then", F);
+    llvm::BasicBlock* ElseBB = llvm::BasicBlock::Create(Context, "else", F);
+    llvm::BasicBlock* MergeBB = llvm::BasicBlock::Create(Context, "ifcont", F);
+    Builder.CreateCondBr(Cond, ThenBB, ElseBB);
+
+    // Each branch that falls through to the merge block contributes a phi operand
+    std::vector<std::pair<llvm::Value*, llvm::BasicBlock*>> Incoming;
+    for (auto [BB, Body] : {std::make_pair(ThenBB, expr->getThen()), std::make_pair(ElseBB, expr->getElse())}) {
+        Builder.SetInsertPoint(BB);
+        HasReturn = false;
+        LastValue = llvm::ConstantFP::get(Context, llvm::APFloat(0.0));
+        if (Body)
+            Body->accept(*this);
+        if (!LastValue)
+            return;
+        if (HasReturn)
+            continue;
+        Incoming.emplace_back(LastValue, Builder.GetInsertBlock());
+        Builder.CreateBr(MergeBB);
+    }
+
+    // Both branches returned: nothing follows the if
+    if (Incoming.empty()) {
+        MergeBB->eraseFromParent();
+        HasReturn = true;
+        return;
+    }
+
+    Builder.SetInsertPoint(MergeBB);
+    HasReturn = false;
+    llvm::PHINode* Phi = Builder.CreatePHI(llvm::Type::getDoubleTy(Context), Incoming.size(), "iftmp");
+    for (auto& [Value, BB] : Incoming)
+        Phi->addIncoming(Value, BB);
+    LastValue = Phi;
+}
+
+void LLVMModuleGenerator::visit(WhileExprAST* expr) {
+    llvm::Function* F = Builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* CondBB = llvm::BasicBlock::Create(Context, "loop", F);
+    llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(Context, "body", F);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(Context, "endloop", F);
+    Builder.CreateBr(CondBB);
+
+    Builder.SetInsertPoint(CondBB);
+    llvm::Value* Cond = emitCondition(expr->getCond(), "loopcond");
+    if (!Cond)
+        return;
+    Builder.CreateCondBr(Cond, BodyBB, AfterBB);
+
+    Builder.SetInsertPoint(BodyBB);
+    expr->getBody()->accept(*this);
+    if (!LastValue)
+        return;
+    if (!HasReturn)
+        Builder.CreateBr(CondBB);
+
+    Builder.SetInsertPoint(AfterBB);
+    HasReturn = false;
+    LastValue = llvm::ConstantFP::get(Context, llvm::APFloat(0.0));
+}
+
+void LLVMModuleGenerator::visit(AssignExprAST* expr) {
+    expr->getValue()->accept(*this);
+    if (!LastValue)
+        return;
+
+    // Every assigned name has a slot: arguments and locals are allocated on entry
+    Builder.CreateStore(LastValue, lookup(expr->getName()));
+}
+
+void LLVMModuleGenerator::visit(CallExprAST* expr) {
+    const auto& ArgExprs = expr->getArgs();
+    std::string_view Name = Symbols->name(expr->getCallee());
+    llvm::StringRef Callee(Name.data(), Name.size());
+
+    // Builtins become intrinsics; anything else is a call to a user function.
+    // Callees that are not defined yet are declared; a later definition fills in the body.
+    const MathBuiltin* Builtin = FindMathBuiltin(Name);
+    llvm::Function* F = nullptr;
+    unsigned Arity;
+    if (Builtin) {
+        Arity = Builtin->Arity;
+    } else {
+        F = TheModule.getFunction(Callee);
+        if (!F) {
+            size_t NumParams = ArgExprs.size();
+            if (Prototypes) {
+                auto Proto = Prototypes->find(Callee);
+                if (Proto != Prototypes->end())
+                    NumParams = Proto->second;
+            }
+            std::vector<llvm::Type*> ArgTypes(NumParams, llvm::Type::getDoubleTy(Context));
+            llvm::FunctionType* FT =
+                llvm::FunctionType::get(llvm::Type::getDoubleTy(Context), ArgTypes, false);
+            F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Callee, TheModule);
+        }
+        Arity = F->arg_size();
+    }
+    if (Arity != ArgExprs.size()) {
+        std::cerr << "Function " << Name << " expects " << Arity
+                  << " arguments, got " << ArgExprs.size() << "\n";
+        LastValue = nullptr;
+        return;
+    }
+
+    std::vector<llvm::Value*> Args;
+    for (const auto& Arg : ArgExprs) {
+        Arg->accept(*this);
+        if (!LastValue)
+            return;
+        Args.push_back(LastValue);
+    }
+    if (Builtin)
+        LastValue = Builder.CreateIntrinsic(Builtin->ID, {llvm::Type::getDoubleTy(Context)}, Args,
+                                            nullptr, Builtin->Name);
+    else
+        LastValue = Builder.CreateCall(F, Args, "calltmp");
+}
+
+void LLVMModuleGenerator::visit(FunctionAST* func) {
+    HasReturn = false;
+    LastFunction = nullptr;
+    Symbols = &func->getSymbols();
+    for (SymbolID Bound : BoundSymbols)
+        NamedValues[Bound] = nullptr;
+    BoundSymbols.clear();
+    if (NamedValues.size() < Symbols->size())
+        NamedValues.resize(Symbols->size(), nullptr);
+
+    const auto& args = func->getArgs();
+    std::vector<llvm::Type*> ArgTypes(args.size(), llvm::Type::getDoubleTy(Context));
+    llvm::FunctionType* FT =
+        llvm::FunctionType::get(llvm::Type::getDoubleTy(Context), ArgTypes, false);
+
+    if (FindMathBuiltin(func->getName())) {
+        std::cerr << "Cannot redefine builtin function: " << func->getName() << "\n";
+        return;
+    }
+
+    // Earlier calls may already have declared the function
+    llvm::Function* F = TheModule.getFunction(func->getName());
+    if (F && !F->empty()) {
+        std::cerr << "Function redefined: " << func->getName() << "\n";
+        return;
+    }
+    if (F && F->arg_size() != args.size()) {
+        std::cerr << "Function " << func->getName() << " is called with " << F->arg_size()
+                  << " arguments but defined with " << args.size() << "\n";
+        return;
+    }
+    if (!F)
+        F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, func->getName(), TheModule);
+
+    llvm::BasicBlock* Entry = llvm::BasicBlock::Create(Context, "entry", F);
+    Builder.SetInsertPoint(Entry);
+
+    // Arguments map straight to their SSA values
+    unsigned Idx = 0;
+    for (auto& Arg : F->args()) {
+        SymbolID Name = args[Idx++];
+        std::string_view Text = Symbols->name(Name);
+        Arg.setName(llvm::StringRef(Text.data(), Text.size()));
+        bind(Name, &Arg);
+    }
+
+    // Only assigned names get a stack slot: arguments start with their value, locals with
+    // 0.0 so a read before any assignment is well defined. mem2reg/SROA promote the slots.
+    for (SymbolID Assigned : CollectAssignedNames(func)) {
+        llvm::Value* Init = lookup(Assigned);
+        if (!Init)
+            Init = llvm::ConstantFP::get(Context, llvm::APFloat(0.0));
+        std::string Name(Symbols->name(Assigned));
+        llvm::AllocaInst* Slot =
+            Builder.CreateAlloca(llvm::Type::getDoubleTy(Context), nullptr, Name + ".addr");
+        Builder.CreateStore(Init, Slot);
+        bind(Assigned, Slot);
+    }
+
+    func->getBody()->accept(*this);
+    if (!LastValue) {
+        discardFunction(F);
+        return;
+    }
+
+    // If the function doesn't end with a return statement, add one
+    if (!HasReturn)
+        Builder.CreateRet(llvm::ConstantFP::get(Context, llvm::APFloat(0.0)));
+
+    if (llvm::verifyFunction(*F, &llvm::errs())) {
+        std::cerr << "Generated invalid IR for function: " << func->getName() << "\n";
+        discardFunction(F);
+        return;
+    }
+
+    LastFunction = F;
+}
+
+void LLVMModuleGenerator::discardFunction(llvm::Function* F) {
+    // Calls from functions generated earlier still refer to it, so keep it as a declaration
+    if (F->use_empty())
+        F->eraseFromParent();
+    else
+        F->deleteBody();
+}
+
+void LLVMModuleGenerator::bind(SymbolID Name, llvm::Value* V) {
+    if (!NamedValues[Name])
+        BoundSymbols.push_back(Name);
+    NamedValues[Name] = V;
+}
+
+llvm::Function* LLVMModuleGenerator::generate(FunctionAST* func) {
+    func->accept(*this);
+    if (LastFunction)
+        ApplyInliningPolicy(LastFunction);
+    return LastFunction;
+}
+
+llvm::Function* GenerateLLVMFunction(FunctionAST* func, llvm::Module& Module, bool FastMath,
+                                     const PrototypeMap* Prototypes) {
+    LLVMModuleGenerator generator(Module, FastMath, Prototypes);
+    return generator.generate(func);
+}
+
+void ApplyInliningPolicy(llvm::Function* F) {
+    unsigned Size = 0;
+    for (const llvm::BasicBlock& BB : *F) {
+        for (const llvm::Instruction& I : BB) {
+            // Intrinsics lower to instructions, so they do not make a function a non-leaf
+            if (auto* Call = llvm::dyn_cast<llvm::CallInst>(&I))
+                if (!llvm::isa<llvm::IntrinsicInst>(Call))
+                    return;
+            if (++Size > AlwaysInlineMaxInstructions)
+                return;
+        }
+    }
+    F->addFnAttr(llvm::Attribute::AlwaysInline);
+}
+
+llvm::Function* GenerateBatchKernel(llvm::Function* Scalar) {
+    llvm::Module& M = *Scalar->getParent();
+    llvm::LLVMContext& Ctx = M.getContext();
+    llvm::IRBuilder<> Builder(Ctx);
+
+    std::string Name = (Scalar->getName() + "_batch").str();
+    if (M.getFunction(Name)) {
+        std::cerr << "Function redefined: " << Name << "\n";
+        return nullptr;
+    }
+
+    llvm::Type* DoubleTy = llvm::Type::getDoubleTy(Ctx);
+    llvm::Type* DoublePtrTy = DoubleTy->getPointerTo();
+    llvm::Type* SizeTy = llvm::Type::getInt64Ty(Ctx);
+
+    // One input column per scalar argument, then the output column and row count
+    std::vector<llvm::Type*> ParamTypes(Scalar->arg_size() + 1, DoublePtrTy);
+    ParamTypes.push_back(SizeTy);
+    llvm::FunctionType* FT = llvm::FunctionType::get(Builder.getVoidTy(), ParamTypes, false);
+    llvm::Function* F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, M);
+
+    unsigned NumCols = Scalar->arg_size();
+    for (unsigned i = 0; i <= NumCols; ++i) {
+        // Columns never alias, which lets the vectorizer skip runtime overlap checks
+        F->addParamAttr(i, llvm::Attribute::NoAlias);
+        F->addParamAttr(i, llvm::Attribute::NoCapture);
+        if (i < NumCols) {
+            F->addParamAttr(i, llvm::Attribute::ReadOnly);
+            F->getArg(i)->setName(Scalar->getArg(i)->getName());
+        }
+    }
+    llvm::Argument* Out = F->getArg(NumCols);
+    llvm::Argument* N = F->getArg(NumCols + 1);
+    Out->setName("out");
+    N->setName("n");
+
+    // The scalar body is folded into the loop once the inliner runs
+    Scalar->addFnAttr(llvm::Attribute::AlwaysInline);
+
+    llvm::BasicBlock* Entry = llvm::BasicBlock::Create(Ctx, "entry", F);
+    llvm::BasicBlock* Loop = llvm::BasicBlock::Create(Ctx, "loop", F);
+    llvm::BasicBlock* Exit = llvm::BasicBlock::Create(Ctx, "exit", F);
+
+    Builder.SetInsertPoint(Entry);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(N, Builder.getInt64(0), "empty"), Exit, Loop);
+
+    Builder.SetInsertPoint(Loop);
+    llvm::PHINode* I = Builder.CreatePHI(SizeTy, 2, "i");
+    I->addIncoming(Builder.getInt64(0), Entry);
+
+    std::vector<llvm::Value*> Row;
+    for (unsigned c = 0; c < NumCols; ++c) {
+        llvm::Value* Ptr = Builder.CreateInBoundsGEP(DoubleTy, F->getArg(c), I);
+        Row.push_back(Builder.CreateLoad(DoubleTy, Ptr, Scalar->getArg(c)->getName()));
+    }
+    llvm::Value* Result = Builder.CreateCall(Scalar, Row, "row");
+    Builder.CreateStore(Result, Builder.CreateInBoundsGEP(DoubleTy, Out, I));
+
+    llvm::Value* Next = Builder.CreateAdd(I, Builder.getInt64(1), "i.next", true, true);
+    I->addIncoming(Next, Loop);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(Next, N, "done"), Exit, Loop);
+
+    Builder.SetInsertPoint(Exit);
+    Builder.CreateRetVoid();
+
+    if (llvm::verifyFunction(*F, &llvm::errs())) {
+        std::cerr << "Generated invalid IR for function: " << Name << "\n";
+        F->eraseFromParent();
+        return nullptr;
+    }
+    return F;
+}
@@ -0,0 +1,140 @@
+#include "flat_ast.hpp"
+#include <algorithm>
+
+// Appends the nodes of a FunctionAST body to a FlatFunction in post-order.
+// Each visit leaves the index of the node it added in Last.
+class Flattener : public CodegenVisitor {
+    FlatFunction& F;
+    NodeIndex Last = NoNode;
+
+    NodeIndex add(FlatKind Kind, uint32_t Payload, NodeIndex First, NodeIndex Second) {
+        F.Kinds.push_back(Kind);
+        F.Payload.push_back(Payload);
+        F.First.push_back(First);
+        F.Second.push_back(Second);
+        return Last = static_cast<NodeIndex>(F.Kinds.size() - 1);
+    }
+
+    NodeIndex flatten(ExprAST* E) {
+        E->accept(*this);
+        return Last;
+    }
+
+    // Flatten a list of expressions and store their indices contiguously in Lists
+    NodeIndex flattenList(const std::vector<ExprPtr>& Exprs) {
+        llvm::SmallVector<NodeIndex, 8> Children;
+        for (const auto& E : Exprs)
+            Children.push_back(flatten(E.get()));
+        NodeIndex Start = static_cast<NodeIndex>(F.Lists.size());
+        F.Lists.insert(F.Lists.end(), Children.begin(), Children.end());
+        return Start;
+    }
+
+public:
+    explicit Flattener(FlatFunction& F) : F(F) {}
+
+    void visit(NumberExprAST* expr) override {
+        F.Numbers.push_back(expr->getValue());
+        add(FlatKind::Number, static_cast<uint32_t>(F.Numbers.size() - 1), NoNode, NoNode);
+    }
+
+    void visit(VariableExprAST* expr) override {
+        add(FlatKind::Variable, expr->getName(), NoNode, NoNode);
+    }
+
+    void visit(BinaryExprAST* expr) override {
+        // Operator chains can be arbitrarily deep; the walk is post-order like the output
+        llvm::SmallVector<NodeIndex, 16> Operands;
+        WalkBinaryTree(
+            expr,
+            [&](ExprPtr& Operand) {
+                Operands.push_back(flatten(Operand.get()));
+                return true;
+            },
+            [&](BinaryExprAST* Node, ExprPtr*) {
+                NodeIndex RHS = Operands.pop_back_val();
+                NodeIndex LHS = Operands.pop_back_val();
+                Operands.push_back(add(FlatKind::Binary,
+                                       static_cast<unsigned char>(Node->getOperator()), LHS, RHS));
+                return true;
+            });
+    }
+
+    void visit(ReturnExprAST* expr) override {
+        NodeIndex Value = flatten(expr->getExpr());
+        add(FlatKind::Return, 0, Value, NoNode);
+    }
+
+    void visit(BlockExprAST* expr) override {
+        NodeIndex Start = flattenList(expr->getExpressions());
+        add(FlatKind::Block, 0, Start, static_cast<NodeIndex>(expr->getExpressions().size()));
+    }
+
+    void visit(IfExprAST* expr) override {
+        NodeIndex Cond = flatten(expr->getCond());
+        NodeIndex Then = flatten(expr->getThen());
+        NodeIndex Else = expr->getElse() ? flatten(expr->getElse()) : NoNode;
+        NodeIndex Branches = static_cast<NodeIndex>(F.Lists.size());
+        F.Lists.push_back(Then);
+        F.Lists.push_back(Else);
+        add(FlatKind::If, 0, Cond, Branches);
+    }
+
+    void visit(WhileExprAST* expr) override {
+        NodeIndex Cond = flatten(expr->getCond());
+        NodeIndex Body = flatten(expr->getBody());
+        add(FlatKind::While, 0, Cond, Body);
+    }
+
+    void visit(AssignExprAST* expr) override {
+        NodeIndex Value = flatten(expr->getValue());
+        add(FlatKind::Assign, expr->getName(), Value, NoNode);
+    }
+
+    void visit(CallExprAST* expr) override {
+        NodeIndex Start = flattenList(expr->getArgs());
+        add(FlatKind::Call, expr->getCallee(), Start, static_cast<NodeIndex>(expr->getArgs().size()));
+    }
+
+    void visit(FunctionAST* func) override {
+        F.DeclaredLocals = func->getDeclaredLocals();
+        F.Root = flatten(func->getBody());
+
+        // The arrays are final now; drop the slack left by their growth
+        F.Kinds.shrink_to_fit();
+        F.Payload.shrink_to_fit();
+        F.First.shrink_to_fit();
+        F.Second.shrink_to_fit();
+        F.Numbers.shrink_to_fit();
+        F.Lists.shrink_to_fit();
+    }
+};
+
+size_t FlatFunction::getBytesAllocated() const {
+    return Kinds.capacity() * sizeof(FlatKind) + Payload.capacity() * sizeof(uint32_t) +
+           (First.capacity() + Second.capacity() + Lists.capacity()) * sizeof(NodeIndex) +
+           Numbers.capacity() * sizeof(double);
+}
+
+FlatFunction FlattenFunction(FunctionAST* func) {
+    FlatFunction F(func->getName(), func->getArgs(), func->getSymbols());
+    Flattener Builder(F);
+    func->accept(Builder);
+    return F;
+}
+
+std::vector<SymbolID> CollectAssignedSymbols(const FlatFunction& F) {
+    // Post-order puts an assignment after everything in its value, which is
+    // the order the tree collector records names in
+    std::vector<SymbolID> Names;
+    for (NodeIndex N = 0, E = static_cast<NodeIndex>(F.size()); N != E; ++N) {
+        if (F.kind(N) != FlatKind::Assign)
+            continue;
+        if (std::find(Names.begin(), Names.end(), F.symbol(N)) == Names.end())
+            Names.push_back(F.symbol(N));
+    }
+    for (SymbolID Local : F.getDeclaredLocals())
+        if (std::find(Names.begin(), Names.end(), Local) == Names.end())
+            Names.push_back(Local);
+    return Names;
+}
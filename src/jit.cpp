@@ -0,0 +1,205 @@
+#include "jit.hpp"
+#include "codegen.hpp"
+#include "optimizer.hpp"
+#include "target.hpp"
+#include <iostream>
+#include <limits>
+#include <mutex>
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+std::unique_ptr<MyLangJIT> MyLangJIT::Create(unsigned OptLevel, bool PrintAfterOpt,
+                                             VectorLibrary VecLib, unsigned CompileThreads) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    // Vectorized math calls into the vector library, which the host process may not link
+    if (VecLib != VectorLibrary::None) {
+        std::string LibName = std::string("lib") + VectorLibraryName(VecLib) + ".so";
+        if (VecLib == VectorLibrary::LIBMVEC)
+            LibName += ".1";
+        std::string ErrMsg;
+        if (llvm::sys::DynamicLibrary::LoadLibraryPermanently(LibName.c_str(), &ErrMsg)) {
+            llvm::errs() << "Failed to create JIT: cannot load " << LibName << ": " << ErrMsg << "\n";
+            return nullptr;
+        }
+    }
+
+    // Target the host CPU so the vectorizers can use its full SIMD width
+    auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB) {
+        llvm::errs() << "Failed to create JIT: " << llvm::toString(JTMB.takeError()) << "\n";
+        return nullptr;
+    }
+
+    auto TM = JTMB->createTargetMachine();
+    if (!TM) {
+        llvm::errs() << "Failed to create JIT: " << llvm::toString(TM.takeError()) << "\n";
+        return nullptr;
+    }
+
+    auto J = llvm::orc::LLJITBuilder()
+                 .setJITTargetMachineBuilder(*JTMB)
+                 .setNumCompileThreads(CompileThreads)
+                 .create();
+    if (!J) {
+        llvm::errs() << "Failed to create JIT: " << llvm::toString(J.takeError()) << "\n";
+        return nullptr;
+    }
+
+    // Optimize each module as it is materialized. Compile threads may run this
+    // concurrently, and TargetMachines are not thread-safe, so each call then
+    // optimizes with its own copy.
+    std::shared_ptr<llvm::TargetMachine> SharedTM = std::move(*TM);
+    auto PrintMutex = std::make_shared<std::mutex>();
+    (*J)->getIRTransformLayer().setTransform(
+        [SharedTM, OptLevel, PrintAfterOpt, VecLib, CompileThreads,
+         PrintMutex](llvm::orc::ThreadSafeModule TSM, const llvm::orc::MaterializationResponsibility&) {
+            TSM.withModuleDo([&](llvm::Module& M) {
+                std::unique_ptr<llvm::TargetMachine> OwnTM;
+                if (CompileThreads > 0)
+                    OwnTM = CloneTargetMachine(*SharedTM);
+                OptimizeModule(M, OptLevel, OwnTM ? OwnTM.get() : SharedTM.get(), VecLib);
+                if (PrintAfterOpt) {
+                    std::lock_guard<std::mutex> Lock(*PrintMutex);
+                    M.print(llvm::errs(), nullptr);
+                }
+            });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(TSM));
+        });
+
+    // Let compiled code resolve symbols from the host process (libm, etc.)
+    auto Generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*J)->getDataLayout().getGlobalPrefix());
+    if (!Generator) {
+        llvm::errs() << "Failed to create JIT: " << llvm::toString(Generator.takeError()) << "\n";
+        return nullptr;
+    }
+    (*J)->getMainJITDylib().addGenerator(std::move(*Generator));
+
+    return std::unique_ptr<MyLangJIT>(new MyLangJIT(std::move(*J)));
+}
+
+bool MyLangJIT::addFunction(FunctionAST* func, bool WithBatchKernel) {
+    // Each compile gets its own context so modules can be handed off to the JIT independently
+    auto Context = std::make_unique<llvm::LLVMContext>();
+    auto Module = std::make_unique<llvm::Module>(func->getName(), *Context);
+    Module->setDataLayout(TheJIT->getDataLayout());
+    Module->setTargetTriple(TheJIT->getTargetTriple().str());
+
+    llvm::Function* F = GenerateLLVMFunction(func, *Module);
+    if (!F)
+        return false;
+    if (WithBatchKernel && !GenerateBatchKernel(F))
+        return false;
+
+    return addModule(llvm::orc::ThreadSafeModule(std::move(Module), std::move(Context)));
+}
+
+llvm::orc::JITDylib* MyLangJIT::createLibrary(const std::string& Name) {
+    auto Lib = TheJIT->createJITDylib(Name);
+    if (!Lib) {
+        llvm::errs() << "JIT error: " << llvm::toString(Lib.takeError()) << "\n";
+        return nullptr;
+    }
+    Lib->addToLinkOrder(TheJIT->getMainJITDylib());
+    return &*Lib;
+}
+
+bool MyLangJIT::removeLibrary(llvm::orc::JITDylib* Lib) {
+    if (auto Err = TheJIT->getExecutionSession().removeJITDylib(*Lib)) {
+        llvm::errs() << "JIT error: " << llvm::toString(std::move(Err)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool MyLangJIT::addModule(llvm::orc::ThreadSafeModule TSM, llvm::orc::JITDylib* Lib) {
+    TSM.withModuleDo([&](llvm::Module& M) {
+        if (M.getTargetTriple().empty())
+            M.setTargetTriple(TheJIT->getTargetTriple().str());
+    });
+
+    if (auto Err = TheJIT->addIRModule(Lib ? *Lib : TheJIT->getMainJITDylib(), std::move(TSM))) {
+        llvm::errs() << "JIT error: " << llvm::toString(std::move(Err)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool MyLangJIT::addObject(std::unique_ptr<llvm::MemoryBuffer> Object) {
+    if (auto Err = TheJIT->addObjectFile(std::move(Object))) {
+        llvm::errs() << "JIT error: " << llvm::toString(std::move(Err)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+void* MyLangJIT::compile(FunctionAST* func) {
+    if (!addFunction(func, false))
+        return nullptr;
+    return lookup(func->getName());
+}
+
+void* MyLangJIT::compileBatch(FunctionAST* func) {
+    if (!addFunction(func, true))
+        return nullptr;
+    return lookup(func->getName() + "_batch");
+}
+
+void* MyLangJIT::lookup(const std::string& Name, llvm::orc::JITDylib* Lib) {
+    auto Sym = TheJIT->lookup(Lib ? *Lib : TheJIT->getMainJITDylib(), Name);
+    if (!Sym) {
+        llvm::errs() << "JIT lookup failed: " << llvm::toString(Sym.takeError()) << "\n";
+        return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return Sym->toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(Sym->getAddress()));
+#endif
+}
+
+bool MyLangJIT::materialize(const std::vector<std::string>& Names, llvm::orc::JITDylib* Lib) {
+    // One lookup for every name lets the session dispatch all their modules at once
+    llvm::orc::SymbolLookupSet Symbols;
+    for (const std::string& Name : Names)
+        Symbols.add(TheJIT->mangleAndIntern(Name));
+
+    llvm::orc::JITDylib& JD = Lib ? *Lib : TheJIT->getMainJITDylib();
+    auto Result = TheJIT->getExecutionSession().lookup(llvm::orc::makeJITDylibSearchOrder(&JD),
+                                                       std::move(Symbols));
+    if (!Result) {
+        llvm::errs() << "JIT lookup failed: " << llvm::toString(Result.takeError()) << "\n";
+        return false;
+    }
+    return true;
+}
+
+double CallJITFunction(void* Addr, const std::vector<double>& A) {
+    using D = double;
+    switch (A.size()) {
+        case 0: return reinterpret_cast<D (*)()>(Addr)();
+        case 1: return reinterpret_cast<D (*)(D)>(Addr)(A[0]);
+        case 2: return reinterpret_cast<D (*)(D, D)>(Addr)(A[0], A[1]);
+        case 3: return reinterpret_cast<D (*)(D, D, D)>(Addr)(A[0], A[1], A[2]);
+        case 4: return reinterpret_cast<D (*)(D, D, D, D)>(Addr)(A[0], A[1], A[2], A[3]);
+        case 5: return reinterpret_cast<D (*)(D, D, D, D, D)>(Addr)(A[0], A[1], A[2], A[3], A[4]);
+        case 6:
+            return reinterpret_cast<D (*)(D, D, D, D, D, D)>(Addr)(A[0], A[1], A[2], A[3], A[4], A[5]);
+        case 7:
+            return reinterpret_cast<D (*)(D, D, D, D, D, D, D)>(Addr)(
+                A[0], A[1], A[2], A[3], A[4], A[5], A[6]);
+        case 8:
+            return reinterpret_cast<D (*)(D, D, D, D, D, D, D, D)>(Addr)(
+                A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7]);
+        default:
+            std::cerr << "Cannot call a function with " << A.size() << " arguments (max "
+                      << MaxJITCallArgs << ")\n";
+            return std::numeric_limits<double>::quiet_NaN();
+    }
+}
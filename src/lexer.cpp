@@ -1,77 +1,116 @@
 #include "lexer.hpp"
-#include <cctype>
-#include <cstdio>
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-std::string IdentifierStr; // filled in if tok_identifier
-double NumVal;             // filled in if tok_number
+// Locale-independent character classes for the scanner's hot loops
+static inline bool IsSpace(char C) {
+    return C == ' ' || C == '\t' || C == '\n' || C == '\r' || C == '\v' || C == '\f';
+}
+static inline bool IsDigit(char C) { return C >= '0' && C <= '9'; }
+static inline bool IsIdentStart(char C) {
+    return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') || C == '_';
+}
+static inline bool IsIdentChar(char C) { return IsIdentStart(C) || IsDigit(C); }
 
-int gettok() {
-    static int LastChar = ' ';
+static double ParseNumber(std::string_view Text) {
+    double Val = 0.0;
+#if defined(__cpp_lib_to_chars)
+    std::from_chars(Text.data(), Text.data() + Text.size(), Val);
+#else
+    // strtod needs a terminated copy; literals are short so a stack buffer is enough
+    char Buf[64];
+    size_t Len = std::min(Text.size(), sizeof(Buf) - 1);
+    std::memcpy(Buf, Text.data(), Len);
+    Buf[Len] = '\0';
+    Val = std::strtod(Buf, nullptr);
+#endif
+    return Val;
+}
 
-    // Skip whitespace
-    while (isspace(LastChar))
-        LastChar = getchar();
+TokenInfo BufferLexer::next() {
+    TokenInfo Tok;
 
-    // Identifier: [a-zA-Z][a-zA-Z0-9]*
-    if (isalpha(LastChar) || LastChar == '_') {
-        IdentifierStr = LastChar;
-        while (isalnum((LastChar = getchar())) || LastChar == '_')
-            IdentifierStr += LastChar;
+    while (true) {
+        // Skip whitespace
+        while (Cur != End && IsSpace(*Cur))
+            ++Cur;
 
-        if (IdentifierStr == "func")
-            return tok_func;
-        if (IdentifierStr == "return")
-            return tok_return;
-        if (IdentifierStr == "if")
-            return tok_if;
-        if (IdentifierStr == "else")
-            return tok_else;
-        if (IdentifierStr == "while")
-            return tok_while;
-        return tok_identifier;
+        // Comment until end of line
+        if (Cur != End && *Cur == '#') {
+            while (Cur != End && *Cur != '\n' && *Cur != '\r')
+                ++Cur;
+            continue;
+        }
+        break;
+    }
+
+    // Check for end of file
+    if (Cur == End) {
+        Tok.Kind = tok_eof;
+        return Tok;
+    }
+
+    const char* Start = Cur;
+
+    // Identifier: [a-zA-Z_][a-zA-Z0-9_]*
+    if (IsIdentStart(*Cur)) {
+        do
+            ++Cur;
+        while (Cur != End && IsIdentChar(*Cur));
+
+        Tok.Text = std::string_view(Start, Cur - Start);
+        if (Tok.Text == "func")
+            Tok.Kind = tok_func;
+        else if (Tok.Text == "return")
+            Tok.Kind = tok_return;
+        else if (Tok.Text == "if")
+            Tok.Kind = tok_if;
+        else if (Tok.Text == "else")
+            Tok.Kind = tok_else;
+        else if (Tok.Text == "while")
+            Tok.Kind = tok_while;
+        else
+            Tok.Kind = tok_identifier;
+        return Tok;
     }
 
     // Number: [0-9]+[.]?[0-9]*
-    if (isdigit(LastChar) || LastChar == '.') {
-        std::string NumStr;
+    if (IsDigit(*Cur) || *Cur == '.') {
         bool hasDecimal = false;
-        
         do {
-            if (LastChar == '.')
+            if (*Cur == '.')
                 hasDecimal = true;
-                
-            NumStr += LastChar;
-            LastChar = getchar();
-        } while (isdigit(LastChar) || (LastChar == '.' && !hasDecimal));
+            ++Cur;
+        } while (Cur != End && (IsDigit(*Cur) || (*Cur == '.' && !hasDecimal)));
 
-        NumVal = strtod(NumStr.c_str(), nullptr);
-        return tok_number;
+        Tok.Kind = tok_number;
+        Tok.Text = std::string_view(Start, Cur - Start);
+        Tok.NumVal = ParseNumber(Tok.Text);
+        return Tok;
     }
 
     // Check for semicolon
-    if (LastChar == ';') {
-        LastChar = getchar();
-        return tok_semicolon;
+    if (*Cur == ';') {
+        ++Cur;
+        Tok.Kind = tok_semicolon;
+        return Tok;
     }
 
-    // Comment until end of line
-    if (LastChar == '#') {
-        do
-            LastChar = getchar();
-        while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+    // Otherwise, return the character as its ASCII value.
+    Tok.Kind = static_cast<unsigned char>(*Cur++);
+    return Tok;
+}
 
-        if (LastChar != EOF)
-            return gettok();
+std::unique_ptr<llvm::MemoryBuffer> LoadSourceFile(const std::string& Path) {
+    // No null terminator is needed, which lets MemoryBuffer mmap large files
+    auto Buffer = llvm::MemoryBuffer::getFileOrSTDIN(Path, /*IsText=*/false,
+                                                     /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+        std::cerr << "Cannot read " << Path << ": " << Buffer.getError().message() << "\n";
+        return nullptr;
     }
-
-    // Check for end of file. Don't eat the EOF.
-    if (LastChar == EOF)
-        return tok_eof;
-
-    // Otherwise, return the character as its ASCII value.
-    int ThisChar = LastChar;
-    LastChar = getchar();
-    return ThisChar;
-}
\ No newline at end of file
+    return std::move(*Buffer);
+}
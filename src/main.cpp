@@ -1,18 +1,620 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
-#include "lexer.hpp"
-#include "parser.hpp"
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cache.hpp"
 #include "codegen.hpp"
+#include "jit.hpp"
+#include "output.hpp"
+#include "server.hpp"
+#include "session.hpp"
+#include "stats.hpp"
+#include "stream.hpp"
+#include "target.hpp"
 
-int main() {
-    std::cout << "Enter code:\n";
-    getNextToken();
+#include "llvm/Support/raw_ostream.h"
 
-    if (auto Func = ParseFunction()) {
-        std::cout << "Parsed a function successfully!\n";
-        GenerateLLVMIR(Func.get());
+struct DriverOptions {
+    bool UseTextIR = false;
+    bool UseJIT = false;
+    bool EmitBatch = false;
+    bool PrintAfterOpt = false;
+    bool FastMath = false;
+    VectorLibrary VecLib = VectorLibrary::None; // --veclib
+    int OptLevel = -1; // -1 = not given: -O0 for IR output, -O2 for --jit
+    TargetSelection Target;
+    std::string ObjectPath; // -c
+    std::string SharedPath; // --shared
+    std::string OutputPath = "-"; // -o; IR output, "-" = standard output
+    unsigned Jobs = 0; // 0 = one per hardware thread
+    unsigned CodegenThreads = 1; // --codegen-threads; 0 = one per hardware thread
+    bool Stream = false; // --stream
+    std::string Entry; // function called by --jit; defaults to the last one defined
+    std::vector<std::string> Inputs;
+    std::vector<double> CallArgs;
+    std::string CacheDir; // --cache-dir; empty = no cache
+    uint64_t CacheBytes = CodeCache::DefaultMaxBytes;
+    bool CacheStats = false;
+    std::string ServerSocket; // --server
+    bool TimeReport = false; // --time-report
+    bool Stats = false; // --stats
+    bool ReportJSON = false; // =json on either flag: one JSON object for both
+
+    bool collectStats() const { return TimeReport || Stats; }
+
+    unsigned codegenThreads() const {
+        return CodegenThreads ? CodegenThreads : std::max(1u, std::thread::hardware_concurrency());
+    }
+};
+
+// Sum of every session's statistics, for --time-report and --stats
+static std::mutex TotalStatsMutex;
+static CompileStats TotalStats;
+
+// Collects one session's statistics (if enabled) and adds them to TotalStats
+// when it goes out of scope; declare it after the session it watches
+class SessionStats {
+    CompileStats Stats;
+    bool Enabled;
+
+public:
+    // For phases that run outside any session, e.g. JIT materialization
+    explicit SessionStats(const DriverOptions& Opts) : Enabled(Opts.collectStats()) {}
+
+    SessionStats(CompilerSession& Session, const DriverOptions& Opts) : SessionStats(Opts) {
+        if (Enabled)
+            Session.setStats(&Stats);
+    }
+    ~SessionStats() {
+        if (!Enabled)
+            return;
+        std::lock_guard<std::mutex> Lock(TotalStatsMutex);
+        TotalStats.merge(Stats);
+    }
+
+    // For PhaseTimer: nullptr when statistics are off
+    CompileStats* get() { return Enabled ? &Stats : nullptr; }
+};
+
+static void PrintUsage(const char* Argv0) {
+    std::cerr << "Usage: " << Argv0 << " [options] [source-files...] [call-args...]\n"
+              << "Reads standard input when no source file is given.\n"
+              << "Numbers after the source file, or after '--', are call-args for --jit.\n"
+              << "Options:\n"
+              << "  --text-ir   Dump textual IR from the string-based generator (debug)\n"
+              << "  --jit       Compile in-process and call a function with call-args\n"
+              << "  --entry F   Function called by --jit (default: the last one defined)\n"
+              << "  --batch     Also emit <name>_batch, a loop over column arrays\n"
+              << "  -O0 .. -O3  Optimization level (default -O0, or -O2 with --jit)\n"
+              << "  -ffast-math Allow rewrites that ignore signed zeros, infinities and NaN\n"
+              << "  --veclib=L  Vectorize sin/cos/exp/log/pow with libmvec or svml (default none)\n"
+              << "  --print-after-opt  Dump each module to stderr after optimization\n"
+              << "  -o FILE     Write IR to FILE instead of standard output\n"
+              << "  -c FILE     Write a native object file\n"
+              << "  --shared FILE  Write a shared library (linked with the system cc)\n"
+              << "  -march=native  Tune and specialize output for the host CPU\n"
+              << "  -mcpu=CPU   Tune and specialize output for CPU (default: generic)\n"
+              << "  -mattr=F    Extra target features, e.g. +avx2,+fma\n"
+              << "  -j N        Compile up to N source files in parallel\n"
+              << "  --codegen-threads N  Generate and optimize the functions of each source\n"
+              << "                   on N threads (0: one per hardware thread; default 1)\n"
+              << "  --stream    Compile and print one definition at a time as the source\n"
+              << "              is read, in constant memory (one module per definition)\n"
+              << "  --cache-dir DIR  Reuse native code for --jit, -c and --shared from DIR\n"
+              << "  --cache-size MB  Evict least recently used cache entries beyond MB (default 256)\n"
+              << "  --cache-stats    Print cache hits and misses to stderr\n"
+              << "  --server SOCKET  Serve compile requests on a Unix socket (-j N workers);\n"
+              << "                   see my_lang_client\n"
+              << "  --time-report[=json]  Print wall and CPU time per compile phase to stderr\n"
+              << "  --stats[=json]        Print token, AST node, IR instruction counts and\n"
+              << "                        memory use to stderr\n"
+              << "  --help      Show this message\n";
+}
+
+// Parse a whole argument as a number (used for --jit call arguments)
+static bool ParseNumberArg(const std::string& Arg, double& Out) {
+    char* End = nullptr;
+    Out = std::strtod(Arg.c_str(), &End);
+    return !Arg.empty() && End == Arg.c_str() + Arg.size();
+}
+
+// Parse, generate and optimize the source loaded into Session; returns false on error.
+// TM, when given, fixes the module's target and drives the optimizer's cost models.
+static bool BuildModule(CompilerSession& Session, const std::string& Path,
+                        const DriverOptions& Opts, unsigned OptLevel, llvm::TargetMachine* TM) {
+    if (!Session.parse()) {
+        std::cerr << Path << ": Error parsing function.\n";
+        return false;
+    }
+
+    Session.setFastMath(Opts.FastMath);
+    Session.simplify();
+
+    if (TM)
+        Session.setTarget(*TM);
+
+    Session.setThreads(Opts.codegenThreads());
+    if (!Session.codegen(Opts.EmitBatch)) {
+        std::cerr << Path << ": Error generating code.\n";
+        return false;
+    }
+    Session.optimize(OptLevel, TM, Opts.VecLib);
+
+    if (Opts.PrintAfterOpt) {
+        std::string Dump;
+        llvm::raw_string_ostream DumpOS(Dump);
+        Session.getModule().print(DumpOS, nullptr);
+        std::cerr << DumpOS.str();
+    }
+    return true;
+}
+
+// Compile one source file and write its IR to OS; returns false on error
+static bool CompileToIR(const std::string& Path, const DriverOptions& Opts, llvm::raw_ostream& OS) {
+    CompilerSession Session;
+    SessionStats Stats(Session, Opts);
+
+    if (Opts.UseTextIR) {
+        if (!Session.loadFile(Path))
+            return false;
+        if (!Session.parse()) {
+            std::cerr << Path << ": Error parsing function.\n";
+            return false;
+        }
+        Session.setFastMath(Opts.FastMath);
+        Session.simplify();
+
+        PhaseTimer Timer(Stats.get(), "text-ir");
+        GenerateLLVMIR(Session.getFunctions(), OS);
+        return true;
+    }
+
+    // Optimized output is specialized for the selected target
+    std::unique_ptr<llvm::TargetMachine> TM;
+    if (Opts.OptLevel > 0) {
+        TM = CreateTargetMachine(Opts.Target, Opts.OptLevel);
+        if (!TM)
+            return false;
+    }
+
+    if (!Session.loadFile(Path) ||
+        !BuildModule(Session, Path, Opts, Opts.OptLevel < 0 ? 0 : Opts.OptLevel, TM.get()))
+        return false;
+
+    PhaseTimer Timer(Stats.get(), "print");
+    Session.getModule().print(OS, nullptr);
+    return true;
+}
+
+// Fetch the object code for one source from Cache, or build it with TM and store it;
+// returns false on error
+static bool LoadOrBuildObject(CodeCache& Cache, const std::string& Path, const DriverOptions& Opts,
+                              unsigned OptLevel, llvm::TargetMachine& TM, CachedObject& Out) {
+    CompilerSession Session;
+    SessionStats Stats(Session, Opts);
+    if (!Session.loadFile(Path))
+        return false;
+
+    // A hit skips parsing, code generation, optimization and emission
+    std::string Key;
+    {
+        PhaseTimer Timer(Stats.get(), "cache");
+        Key = ComputeCacheKey(Session.getSource(), TM, OptLevel, Opts.FastMath, Opts.EmitBatch,
+                              Opts.VecLib);
+        if (auto Entry = Cache.lookup(Key)) {
+            if (Out.deserialize(Entry->getBuffer()))
+                return true;
+            std::cerr << "Ignoring corrupt cache entry " << Key << "\n";
+        }
+    }
+
+    if (!BuildModule(Session, Path, Opts, OptLevel, &TM))
+        return false;
+
+    llvm::SmallVector<char, 0> Object;
+    {
+        PhaseTimer Timer(Stats.get(), "emit");
+        if (!EmitObject(Session.getModule(), TM, Object))
+            return false;
+    }
+
+    Out.Functions.clear();
+    for (const auto& Func : Session.getFunctions())
+        Out.Functions.emplace_back(Func->getName(), Func->getArgs().size());
+    Out.Object.assign(Object.begin(), Object.end());
+    PhaseTimer Timer(Stats.get(), "cache");
+    Cache.store(Key, Out.serialize());
+    return true;
+}
+
+// Compile one source to a native object or shared library
+static int CompileToNative(const DriverOptions& Opts, CodeCache* Cache) {
+    unsigned OptLevel = Opts.OptLevel < 0 ? 0 : Opts.OptLevel;
+    auto TM = CreateTargetMachine(Opts.Target, OptLevel);
+    if (!TM)
+        return 1;
+
+    if (Cache) {
+        CachedObject Compiled;
+        if (!LoadOrBuildObject(*Cache, Opts.Inputs[0], Opts, OptLevel, *TM, Compiled))
+            return 1;
+        if (!Opts.ObjectPath.empty() && !WriteObjectFile(Compiled.Object, Opts.ObjectPath))
+            return 1;
+        if (!Opts.SharedPath.empty() && !LinkSharedLibrary(Compiled.Object, Opts.SharedPath,
+                                                             VectorLibraryName(Opts.VecLib)))
+            return 1;
+        return 0;
+    }
+
+    CompilerSession Session;
+    SessionStats Stats(Session, Opts);
+    if (!Session.loadFile(Opts.Inputs[0]) ||
+        !BuildModule(Session, Opts.Inputs[0], Opts, OptLevel, TM.get()))
+        return 1;
+
+    PhaseTimer Timer(Stats.get(), "emit"); // includes linking for --shared
+    if (!Opts.ObjectPath.empty() && !EmitObjectFile(Session.getModule(), *TM, Opts.ObjectPath))
+        return 1;
+    if (!Opts.SharedPath.empty() && !EmitSharedLibrary(Session.getModule(), *TM, Opts.SharedPath,
+                                                         VectorLibraryName(Opts.VecLib)))
+        return 1;
+    return 0;
+}
+
+// Compile every input on a pool of threads, one CompilerSession each,
+// and write the results to OS in input order
+static int CompileAll(const DriverOptions& Opts, llvm::raw_ostream& OS) {
+    size_t N = Opts.Inputs.size();
+
+    // A single input is written straight to OS, without an intermediate copy
+    if (N == 1)
+        return CompileToIR(Opts.Inputs[0], Opts, OS) ? 0 : 1;
+
+    std::vector<std::string> Outputs(N);
+    std::vector<char> Succeeded(N, 0);
+    std::atomic<size_t> Next{0};
+
+    unsigned Jobs = Opts.Jobs ? Opts.Jobs : std::max(1u, std::thread::hardware_concurrency());
+    Jobs = static_cast<unsigned>(std::min<size_t>(Jobs, N));
+
+    auto Worker = [&] {
+        for (size_t i = Next++; i < N; i = Next++) {
+            llvm::raw_string_ostream Out(Outputs[i]);
+            Succeeded[i] = CompileToIR(Opts.Inputs[i], Opts, Out);
+        }
+    };
+
+    std::vector<std::thread> Threads;
+    for (unsigned t = 1; t < Jobs; ++t)
+        Threads.emplace_back(Worker);
+    Worker();
+    for (auto& T : Threads)
+        T.join();
+
+    int Status = 0;
+    for (size_t i = 0; i < N; ++i) {
+        OS << Outputs[i];
+        std::string().swap(Outputs[i]);
+        if (!Succeeded[i])
+            Status = 1;
+    }
+    return Status;
+}
+
+// Compile one source definition by definition as it is read (--stream)
+static int CompileStreaming(const DriverOptions& Opts, llvm::raw_ostream& OS) {
+    StreamOptions Stream;
+    Stream.OptLevel = Opts.OptLevel < 0 ? 0 : Opts.OptLevel;
+    Stream.FastMath = Opts.FastMath;
+    Stream.WithBatchKernel = Opts.EmitBatch;
+    Stream.VecLib = Opts.VecLib;
+
+    // Optimized output is specialized for the selected target
+    std::unique_ptr<llvm::TargetMachine> TM;
+    if (Stream.OptLevel > 0) {
+        TM = CreateTargetMachine(Opts.Target, Stream.OptLevel);
+        if (!TM)
+            return 1;
+        Stream.TM = TM.get();
+    }
+
+    SessionStats Stats(Opts);
+    Stream.Stats = Stats.get();
+    return CompileStream(Opts.Inputs[0], Stream, OS) ? 0 : 1;
+}
+
+// Pick the function --jit calls from a translation unit's (name, arity) list
+// and check it against the call arguments; returns false on error
+static bool SelectEntry(const DriverOptions& Opts,
+                        const std::vector<std::pair<std::string, unsigned>>& Functions,
+                        std::string& Entry) {
+    if (Functions.empty()) {
+        std::cerr << "No functions to run.\n";
+        return false;
+    }
+
+    auto Func = Functions.end() - 1;
+    if (!Opts.Entry.empty()) {
+        Func = std::find_if(Functions.begin(), Functions.end(),
+                            [&](const auto& F) { return F.first == Opts.Entry; });
+        if (Func == Functions.end()) {
+            std::cerr << "No function named " << Opts.Entry << "\n";
+            return false;
+        }
+    }
+
+    if (Func->second > MaxJITCallArgs) {
+        std::cerr << "Function " << Func->first << " has " << Func->second
+                  << " parameters; --jit can call functions with at most " << MaxJITCallArgs
+                  << "\n";
+        return false;
+    }
+    if (Opts.CallArgs.size() != Func->second) {
+        std::cerr << "Function " << Func->first << " expects " << Func->second
+                  << " arguments, got " << Opts.CallArgs.size() << "\n";
+        return false;
+    }
+    Entry = Func->first;
+    return true;
+}
+
+static int RunJIT(const DriverOptions& Opts, CodeCache* Cache) {
+    unsigned OptLevel = Opts.OptLevel < 0 ? 2 : Opts.OptLevel;
+    std::string EntryName;
+    std::unique_ptr<MyLangJIT> JIT;
+
+    if (Cache) {
+        // Cached objects are built for the host, the same target the JIT uses
+        TargetSelection Host;
+        Host.CPU = "native";
+        auto TM = CreateTargetMachine(Host, OptLevel);
+        CachedObject Compiled;
+        if (!TM || !LoadOrBuildObject(*Cache, Opts.Inputs[0], Opts, OptLevel, *TM, Compiled))
+            return 1;
+        if (!SelectEntry(Opts, Compiled.Functions, EntryName))
+            return 1;
+
+        JIT = MyLangJIT::Create(OptLevel, false, Opts.VecLib);
+        if (!JIT || !JIT->addObject(llvm::MemoryBuffer::getMemBufferCopy(Compiled.Object)))
+            return 1;
     } else {
-        std::cerr << "Error parsing function.\n";
+        CompilerSession Session;
+        SessionStats Stats(Session, Opts);
+        if (!Session.loadFile(Opts.Inputs[0]))
+            return 1;
+
+        if (!Session.parse()) {
+            std::cerr << "Error parsing function.\n";
+            return 1;
+        }
+        std::cerr << "Parsed " << Session.getFunctions().size() << " function(s) successfully!\n";
+        Session.setFastMath(Opts.FastMath);
+        Session.simplify();
+
+        std::vector<std::pair<std::string, unsigned>> Functions;
+        for (const auto& F : Session.getFunctions())
+            Functions.emplace_back(F->getName(), F->getArgs().size());
+        if (!SelectEntry(Opts, Functions, EntryName))
+            return 1;
+
+        // With several codegen threads the JIT also optimizes and compiles on them
+        unsigned Threads = Opts.codegenThreads();
+        JIT = MyLangJIT::Create(OptLevel, Opts.PrintAfterOpt, Opts.VecLib, Threads > 1 ? Threads : 0);
+        if (!JIT)
+            return 1;
+
+        // The translation unit goes to the JIT as one module, or one per shard
+        Session.setThreads(Threads);
+        if (!Session.codegen()) {
+            std::cerr << "Error generating code.\n";
+            return 1;
+        }
+        auto Modules = Session.takeModules();
+        bool Sharded = Modules.size() > 1;
+        for (auto& TSM : Modules)
+            if (!JIT->addModule(std::move(TSM)))
+                return 1;
+
+        // Compile every shard up front, in parallel, rather than as calls reach them
+        if (Sharded) {
+            std::vector<std::string> Names;
+            for (const auto& F : Functions)
+                Names.push_back(F.first);
+            SessionStats Stats(Opts);
+            PhaseTimer Timer(Stats.get(), "jit");
+            if (!JIT->materialize(Names))
+                return 1;
+        }
     }
 
+    // The JIT optimizes and emits lazily, so this phase covers both
+    void* Addr;
+    {
+        SessionStats Stats(Opts);
+        PhaseTimer Timer(Stats.get(), "jit");
+        Addr = JIT->lookup(EntryName);
+    }
+    if (!Addr)
+        return 1;
+
+    std::cout << CallJITFunction(Addr, Opts.CallArgs) << "\n";
     return 0;
-}
\ No newline at end of file
+}
+
+static void PrintCacheStats(const CodeCache& Cache) {
+    auto [Entries, Bytes] = Cache.getUsage();
+    std::cerr << "cache: " << Cache.getHits() << " hits, " << Cache.getMisses() << " misses, "
+              << Entries << " entries, " << Bytes << " bytes\n";
+}
+
+int main(int argc, char** argv) {
+    DriverOptions Opts;
+    bool OnlyCallArgs = false; // after "--"
+
+    for (int i = 1; i < argc; ++i) {
+        std::string Arg = argv[i];
+        double Num;
+
+        // Numbers are call arguments once the source is known, so a source file
+        // may have a numeric name; "--" starts them when reading standard input
+        bool IsNumber = ParseNumberArg(Arg, Num);
+        if (OnlyCallArgs || (IsNumber && !Opts.Inputs.empty())) {
+            if (!IsNumber) {
+                std::cerr << "Call argument is not a number: " << Arg << "\n";
+                return 1;
+            }
+            Opts.CallArgs.push_back(Num);
+            continue;
+        }
+
+        if (Arg == "--") {
+            OnlyCallArgs = true;
+        } else if (Arg == "--text-ir") {
+            Opts.UseTextIR = true;
+        } else if (Arg == "--jit") {
+            Opts.UseJIT = true;
+        } else if (Arg == "--entry" && i + 1 < argc) {
+            Opts.Entry = argv[++i];
+        } else if (Arg == "--batch") {
+            Opts.EmitBatch = true;
+        } else if (Arg.size() == 3 && Arg[0] == '-' && Arg[1] == 'O' && Arg[2] >= '0' && Arg[2] <= '3') {
+            Opts.OptLevel = Arg[2] - '0';
+        } else if (Arg == "-ffast-math") {
+            Opts.FastMath = true;
+        } else if (Arg.rfind("--veclib=", 0) == 0) {
+            if (!ParseVectorLibrary(Arg.substr(9), Opts.VecLib)) {
+                std::cerr << "Unknown vector library: " << Arg.substr(9) << "\n";
+                return 1;
+            }
+        } else if (Arg == "--print-after-opt") {
+            Opts.PrintAfterOpt = true;
+        } else if (Arg == "-o" && i + 1 < argc) {
+            Opts.OutputPath = argv[++i];
+        } else if (Arg == "-c" && i + 1 < argc) {
+            Opts.ObjectPath = argv[++i];
+        } else if (Arg == "--shared" && i + 1 < argc) {
+            Opts.SharedPath = argv[++i];
+        } else if (Arg == "-march=native") {
+            Opts.Target.CPU = "native";
+        } else if (Arg.rfind("-mcpu=", 0) == 0) {
+            Opts.Target.CPU = Arg.substr(6);
+        } else if (Arg.rfind("-mattr=", 0) == 0) {
+            Opts.Target.Features = Arg.substr(7);
+        } else if (Arg == "-j" && i + 1 < argc) {
+            Opts.Jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (Arg.rfind("-j", 0) == 0 && Arg.size() > 2) {
+            Opts.Jobs = static_cast<unsigned>(std::atoi(Arg.c_str() + 2));
+        } else if (Arg == "--codegen-threads" && i + 1 < argc) {
+            Opts.CodegenThreads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (Arg == "--stream") {
+            Opts.Stream = true;
+        } else if (Arg == "--cache-dir" && i + 1 < argc) {
+            Opts.CacheDir = argv[++i];
+        } else if (Arg == "--cache-size" && i + 1 < argc) {
+            Opts.CacheBytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (Arg == "--server" && i + 1 < argc) {
+            Opts.ServerSocket = argv[++i];
+        } else if (Arg == "--time-report" || Arg == "--time-report=json") {
+            Opts.TimeReport = true;
+            Opts.ReportJSON |= Arg.size() > 13;
+        } else if (Arg == "--stats" || Arg == "--stats=json") {
+            Opts.Stats = true;
+            Opts.ReportJSON |= Arg.size() > 7;
+        } else if (Arg == "--cache-stats") {
+            Opts.CacheStats = true;
+        } else if (Arg == "--help" || Arg == "-h") {
+            PrintUsage(argv[0]);
+            return 0;
+        } else if (Arg[0] != '-' || IsNumber) {
+            Opts.Inputs.push_back(Arg);
+        } else {
+            std::cerr << "Unknown option: " << Arg << "\n";
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!Opts.CallArgs.empty() && !Opts.UseJIT) {
+        std::cerr << "Call arguments are only used with --jit\n";
+        return 1;
+    }
+
+    if (!Opts.ServerSocket.empty()) {
+        CompileServer Server(Opts.Jobs);
+        if (!Server.listen(Opts.ServerSocket))
+            return 1;
+        std::cerr << "Listening on " << Opts.ServerSocket << "\n";
+        Server.run();
+        return 0;
+    }
+
+    if (Opts.Inputs.empty()) {
+        Opts.Inputs.push_back("-");
+        // Prompts go to stderr so stdout only carries the generated IR
+        std::cerr << "Enter code:\n";
+    }
+
+    std::unique_ptr<CodeCache> Cache;
+    if (!Opts.CacheDir.empty()) {
+        Cache = std::make_unique<CodeCache>(Opts.CacheDir, Opts.CacheBytes);
+        if (!Cache->init())
+            return 1;
+    }
+
+    // IR goes to the -o file; --jit, -c and --shared have their own outputs
+    bool WritesIR = !Opts.UseJIT && Opts.ObjectPath.empty() && Opts.SharedPath.empty();
+    if (!WritesIR && Opts.OutputPath != "-") {
+        std::cerr << "-o names the IR output; it cannot be combined with --jit, -c or --shared\n";
+        return 1;
+    }
+    if (Opts.Stream && (!WritesIR || Opts.Inputs.size() != 1 || Opts.UseTextIR || Cache)) {
+        std::cerr << "--stream writes the LLVM IR of a single source; it cannot be combined "
+                     "with --jit, --text-ir, -c, --shared or --cache-dir\n";
+        return 1;
+    }
+
+    int Status;
+    if (WritesIR) {
+        auto OS = OpenOutputFile(Opts.OutputPath);
+        if (!OS)
+            return 1;
+        Status = Opts.Stream ? CompileStreaming(Opts, *OS) : CompileAll(Opts, *OS);
+
+        OS->flush();
+        if (OS->has_error()) {
+            std::cerr << "Cannot write " << Opts.OutputPath << ": " << OS->error().message() << "\n";
+            OS->clear_error();
+            Status = 1;
+        }
+    } else if (Opts.UseJIT) {
+        if (Opts.Inputs.size() != 1) {
+            std::cerr << "--jit takes a single source file\n";
+            return 1;
+        }
+        Status = RunJIT(Opts, Cache.get());
+    } else if (!Opts.ObjectPath.empty() || !Opts.SharedPath.empty()) {
+        if (Opts.Inputs.size() != 1) {
+            std::cerr << "-c and --shared take a single source file\n";
+            return 1;
+        }
+        Status = CompileToNative(Opts, Cache.get());
+    }
+
+    if (Cache && Opts.CacheStats)
+        PrintCacheStats(*Cache);
+
+    if (Opts.ReportJSON) {
+        PrintStatsJSON(TotalStats, Opts.TimeReport, Opts.Stats, llvm::errs());
+    } else {
+        if (Opts.TimeReport)
+            PrintTimeReport(TotalStats, llvm::errs());
+        if (Opts.Stats)
+            PrintStats(TotalStats, llvm::errs());
+    }
+    return Status;
+}
@@ -0,0 +1,65 @@
+#include "optimizer.hpp"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+
+bool ParseVectorLibrary(std::string_view Name, VectorLibrary& Out) {
+    if (Name == "none")
+        Out = VectorLibrary::None;
+    else if (Name == "libmvec")
+        Out = VectorLibrary::LIBMVEC;
+    else if (Name == "svml")
+        Out = VectorLibrary::SVML;
+    else
+        return false;
+    return true;
+}
+
+const char* VectorLibraryName(VectorLibrary VecLib) {
+    switch (VecLib) {
+        case VectorLibrary::LIBMVEC: return "mvec";
+        case VectorLibrary::SVML: return "svml";
+        case VectorLibrary::None: break;
+    }
+    return "";
+}
+
+void OptimizeModule(llvm::Module& Module, unsigned OptLevel, llvm::TargetMachine* TM,
+                    VectorLibrary VecLib) {
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    // Registered before the defaults so the vectorizer sees the vector library's functions
+    llvm::TargetLibraryInfoImpl TLII(llvm::Triple(Module.getTargetTriple()));
+    if (VecLib == VectorLibrary::LIBMVEC)
+        TLII.addVectorizableFunctionsFromVecLib(llvm::TargetLibraryInfoImpl::LIBMVEC_X86);
+    else if (VecLib == VectorLibrary::SVML)
+        TLII.addVectorizableFunctionsFromVecLib(llvm::TargetLibraryInfoImpl::SVML);
+    FAM.registerPass([&] { return llvm::TargetLibraryAnalysis(TLII); });
+
+    llvm::PipelineTuningOptions PTO;
+    PTO.LoopVectorization = OptLevel >= 2;
+    PTO.SLPVectorization = OptLevel >= 2;
+
+    llvm::PassBuilder PB(TM, PTO);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::ModulePassManager MPM;
+    if (OptLevel == 0) {
+        MPM = PB.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+    } else {
+        llvm::OptimizationLevel Level = OptLevel == 1   ? llvm::OptimizationLevel::O1
+                                        : OptLevel == 2 ? llvm::OptimizationLevel::O2
+                                                        : llvm::OptimizationLevel::O3;
+        MPM = PB.buildPerModuleDefaultPipeline(Level);
+    }
+    MPM.run(Module, MAM);
+}
@@ -0,0 +1,15 @@
+#include "output.hpp"
+#include <iostream>
+
+#include "llvm/Support/FileSystem.h"
+
+std::unique_ptr<llvm::raw_fd_ostream> OpenOutputFile(const std::string& Path) {
+    std::error_code EC;
+    auto OS = std::make_unique<llvm::raw_fd_ostream>(Path, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        std::cerr << "Cannot write " << Path << ": " << EC.message() << "\n";
+        return nullptr;
+    }
+    OS->SetBufferSize(OutputBufferSize);
+    return OS;
+}
@@ -0,0 +1,73 @@
+#include "parallel.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+// The indices a thread has not started yet; owner takes from the front, thieves from the back
+struct WorkBlock {
+    std::mutex Lock;
+    size_t Begin = 0, End = 0;
+};
+} // namespace
+
+void ParallelFor(size_t N, unsigned Threads, llvm::function_ref<void(size_t, unsigned)> Fn) {
+    Threads = static_cast<unsigned>(std::min<size_t>(std::max(1u, Threads), N));
+    if (Threads <= 1) {
+        for (size_t i = 0; i < N; ++i)
+            Fn(i, 0);
+        return;
+    }
+
+    std::unique_ptr<WorkBlock[]> Blocks(new WorkBlock[Threads]);
+    for (unsigned t = 0; t < Threads; ++t) {
+        Blocks[t].Begin = N * t / Threads;
+        Blocks[t].End = N * (t + 1) / Threads;
+    }
+
+    // Move the upper half of a victim's remaining block into Self; false when all are empty
+    auto Steal = [&](unsigned Self) {
+        for (unsigned k = 1; k < Threads; ++k) {
+            WorkBlock& Victim = Blocks[(Self + k) % Threads];
+            size_t Begin, End;
+            {
+                std::lock_guard<std::mutex> Lock(Victim.Lock);
+                size_t Left = Victim.End - Victim.Begin;
+                if (Left == 0)
+                    continue;
+                End = Victim.End;
+                Begin = End - (Left + 1) / 2;
+                Victim.End = Begin;
+            }
+            std::lock_guard<std::mutex> Lock(Blocks[Self].Lock);
+            Blocks[Self].Begin = Begin;
+            Blocks[Self].End = End;
+            return true;
+        }
+        return false;
+    };
+
+    auto Worker = [&](unsigned Self) {
+        WorkBlock& Own = Blocks[Self];
+        while (true) {
+            size_t Index;
+            {
+                std::lock_guard<std::mutex> Lock(Own.Lock);
+                Index = Own.Begin < Own.End ? Own.Begin++ : N;
+            }
+            if (Index < N)
+                Fn(Index, Self);
+            else if (!Steal(Self))
+                return;
+        }
+    };
+
+    std::vector<std::thread> Pool;
+    for (unsigned t = 1; t < Threads; ++t)
+        Pool.emplace_back(Worker, t);
+    Worker(0);
+    for (auto& T : Pool)
+        T.join();
+}
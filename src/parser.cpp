@@ -1,72 +1,75 @@
 #include "parser.hpp"
 #include "lexer.hpp"
 #include "ast.hpp"
+#include <cstring>
 #include <iostream>
 #include <memory>
-#include <map>
 
-int CurTok;
-int getNextToken() { return CurTok = gettok(); }
+#include "llvm/ADT/SmallVector.h"
 
-// Operator precedence for binary operations
-std::map<char, int> BinopPrecedence = {
-    {'<', 10},
-    {'+', 20},
-    {'-', 20},
-    {'*', 40},
-    {'/', 40}
-};
+Parser::Parser(std::string_view Source, ASTArena& Arena, const BinopTable& Binops)
+    : Lexer(Source), Arena(Arena), Binops(Binops) {}
 
-// Get the precedence of the current token
-int GetTokenPrecedence() {
-    if (!isascii(CurTok))
-        return -1;
-
-    int TokPrec = BinopPrecedence[CurTok];
-    if (TokPrec <= 0)
-        return -1;
-    return TokPrec;
+int Parser::getNextToken() {
+    Tok = Lexer.next();
+    ++TokenCount;
+    return CurTok = Tok.Kind;
 }
 
-// Forward declarations
-std::unique_ptr<ExprAST> ParseExpression();
-std::unique_ptr<ExprAST> ParsePrimary();
+// Get the precedence of the current token
+int Parser::GetTokenPrecedence() {
+    return GetBinopPrecedence(CurTok);
+}
 
 // Parse number literals
-std::unique_ptr<ExprAST> ParseNumberExpr() {
-    auto Result = std::make_unique<NumberExprAST>(NumVal);
+ExprPtr Parser::ParseNumberExpr() {
+    auto Result = Arena.make<NumberExprAST>(Tok.NumVal);
     getNextToken(); // consume the number
     return std::move(Result);
 }
 
-// Parse identifiers and function calls
-std::unique_ptr<ExprAST> ParseIdentifierExpr() {
-    std::string IdName = IdentifierStr;
+// Parse identifiers, assignments and function calls
+ExprPtr Parser::ParseIdentifierExpr() {
+    SymbolID IdName = Arena.intern(Tok.Text);
     getNextToken(); // consume identifier
-    
-    // Simple variable reference
-    return std::make_unique<VariableExprAST>(IdName);
-}
 
-// Parse parenthesized expressions
-std::unique_ptr<ExprAST> ParseParenExpr() {
-    getNextToken(); // consume '('
-    auto V = ParseExpression();
-    if (!V) {
-        std::cerr << "Expected expression after '('\n";
-        return nullptr;
+    // Assignment: name = expression
+    if (CurTok == '=') {
+        getNextToken(); // consume '='
+        auto Value = ParseExpression();
+        if (!Value)
+            return nullptr;
+        return Arena.make<AssignExprAST>(IdName, std::move(Value));
     }
+    
+    // Function call: name(arg, ...)
+    if (CurTok == '(') {
+        getNextToken(); // consume '('
+        std::vector<ExprPtr> Args;
+        while (CurTok != ')') {
+            auto Arg = ParseExpression();
+            if (!Arg)
+                return nullptr;
+            Args.push_back(std::move(Arg));
 
-    if (CurTok != ')') {
-        std::cerr << "Expected ')'\n";
-        return nullptr;
+            if (CurTok == ')')
+                break;
+            if (CurTok != ',') {
+                std::cerr << "Expected ')' or ',' in argument list\n";
+                return nullptr;
+            }
+            getNextToken(); // consume ','
+        }
+        getNextToken(); // consume ')'
+        return Arena.make<CallExprAST>(IdName, std::move(Args));
     }
-    getNextToken(); // consume ')'
-    return V;
+
+    // Simple variable reference
+    return Arena.make<VariableExprAST>(IdName);
 }
 
 // Parse return statements
-std::unique_ptr<ExprAST> ParseReturnExpr() {
+ExprPtr Parser::ParseReturnExpr() {
     getNextToken(); // consume 'return'
     
     // Parse the return value
@@ -81,71 +84,90 @@ std::unique_ptr<ExprAST> ParseReturnExpr() {
         getNextToken(); // consume ';'
     }
     
-    return std::make_unique<ReturnExprAST>(std::move(RetVal));
+    return Arena.make<ReturnExprAST>(std::move(RetVal));
 }
 
 // Parse primary expressions
-std::unique_ptr<ExprAST> ParsePrimary() {
+ExprPtr Parser::ParsePrimary() {
     switch (CurTok) {
     case tok_identifier:
         return ParseIdentifierExpr();
     case tok_number:
         return ParseNumberExpr();
-    case '(':
-        return ParseParenExpr();
     case tok_return:
         return ParseReturnExpr();
+    case tok_if:
+        return ParseIfExpr();
+    case tok_while:
+        return ParseWhileExpr();
     default:
         std::cerr << "Unknown token when expecting an expression: " << CurTok << "\n";
         return nullptr;
     }
 }
 
-// Parse binary operations with operator precedence
-std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS) {
-    while (true) {
-        // Get the precedence of the current token
-        int TokPrec = GetTokenPrecedence();
+// Parse expressions: operands separated by binary operators, with parentheses.
+// Shunting-yard over explicit operand and operator stacks, so deep nesting and long
+// operator chains take linear time and heap space instead of recursion.
+ExprPtr Parser::ParseExpression() {
+    llvm::SmallVector<ExprPtr, 8> Operands;
+    llvm::SmallVector<int, 8> Operators; // binary operators and '(' markers
+    size_t OpenParens = 0;
 
-        // If this is a binary operator with too low precedence, return the expression so far
-        if (TokPrec < ExprPrec)
-            return LHS;
-
-        // We have a binary operator
-        int BinOp = CurTok;
-        getNextToken(); // consume binary operator
+    // Combine the top two operands with the top operator
+    auto Reduce = [&] {
+        ExprPtr RHS = Operands.pop_back_val();
+        ExprPtr& LHS = Operands.back();
+        LHS = Arena.make<BinaryExprAST>(Operators.pop_back_val(), std::move(LHS), std::move(RHS));
+    };
 
-        // Parse the primary expression after the binary operator
-        auto RHS = ParsePrimary();
-        if (!RHS)
+    while (true) {
+        // An operand, after any number of opening parentheses
+        while (CurTok == '(') {
+            getNextToken(); // consume '('
+            Operators.push_back('(');
+            ++OpenParens;
+        }
+        auto Operand = ParsePrimary();
+        if (!Operand)
             return nullptr;
+        Operands.push_back(std::move(Operand));
 
-        // Get the precedence of the next operator
-        int NextPrec = GetTokenPrecedence();
-        if (TokPrec < NextPrec) {
-            // If the next operator has higher precedence, parse it first
-            RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
-            if (!RHS)
-                return nullptr;
+        // Close parentheses opened in this expression; any other ')' ends it
+        while (CurTok == ')' && OpenParens > 0) {
+            while (Operators.back() != '(')
+                Reduce();
+            Operators.pop_back();
+            --OpenParens;
+            getNextToken(); // consume ')'
         }
 
-        // Merge LHS and RHS into a binary expression
-        LHS = std::make_unique<BinaryExprAST>(BinOp, std::move(LHS), std::move(RHS));
+        // Then a binary operator, or the end of the expression
+        int TokPrec = GetTokenPrecedence();
+        if (TokPrec < 0)
+            break;
+
+        // Reduce tighter operators first; equal precedence reduces only when left-associative
+        int Bias = Binops.RightAssoc[CurTok] ? 1 : 0;
+        while (!Operators.empty() && Operators.back() != '(' &&
+               GetBinopPrecedence(Operators.back()) >= TokPrec + Bias)
+            Reduce();
+        Operators.push_back(CurTok);
+        getNextToken(); // consume binary operator
     }
-}
 
-// Parse expressions
-std::unique_ptr<ExprAST> ParseExpression() {
-    auto LHS = ParsePrimary();
-    if (!LHS)
+    if (OpenParens > 0) {
+        std::cerr << "Expected ')'\n";
         return nullptr;
-
-    return ParseBinOpRHS(0, std::move(LHS));
+    }
+    while (!Operators.empty())
+        Reduce();
+    return std::move(Operands.back());
 }
 
 // Parse a block of expressions
-std::unique_ptr<ExprAST> ParseBlock() {
-    std::vector<std::unique_ptr<ExprAST>> Expressions;
+ExprPtr Parser::ParseBlock() {
+    std::vector<ExprPtr> Expressions;
     
     while (CurTok != '}' && CurTok != tok_eof) {
         auto Expr = ParseExpression();
@@ -155,10 +177,15 @@ std::unique_ptr<ExprAST> ParseBlock() {
         Expressions.push_back(std::move(Expr));
         
         // Check if the expression is a return statement
-        bool isReturn = dynamic_cast<ReturnExprAST*>(Expressions.back().get()) != nullptr;
+        ExprAST* Last = Expressions.back().get();
+        bool isReturn = dynamic_cast<ReturnExprAST*>(Last) != nullptr;
+        bool isBraced = dynamic_cast<IfExprAST*>(Last) || dynamic_cast<WhileExprAST*>(Last);
         
-        // Expect a semicolon after each expression except return (return already consumed the semicolon if present)
-        if (!isReturn) {
+        // Expect a semicolon after each expression except return (return already consumed the semicolon if present),
+        // if/while, which end in '}', and the last expression of the block
+        if (isBraced && (CurTok == ';' || CurTok == tok_semicolon)) {
+            getNextToken(); // consume optional ';'
+        } else if (!isReturn && !isBraced && CurTok != '}') {
             if (CurTok != ';' && CurTok != tok_semicolon) {
                 std::cerr << "Expected ';' after expression\n";
                 return nullptr;
@@ -173,11 +200,69 @@ std::unique_ptr<ExprAST> ParseBlock() {
     }
     
     // Properly create a BlockExprAST with all expressions
-    return std::make_unique<BlockExprAST>(std::move(Expressions));
+    return Arena.make<BlockExprAST>(std::move(Expressions));
+}
+
+// Parse '{' block '}'
+ExprPtr Parser::ParseBracedBlock() {
+    if (CurTok != '{') {
+        std::cerr << "Expected '{'\n";
+        return nullptr;
+    }
+    getNextToken(); // consume '{'
+
+    auto Body = ParseBlock();
+    if (!Body)
+        return nullptr;
+
+    if (CurTok != '}') {
+        std::cerr << "Expected '}'\n";
+        return nullptr;
+    }
+    getNextToken(); // consume '}'
+    return Body;
+}
+
+// Parse 'if cond { ... }', optionally followed by 'else { ... }' or 'else if ...'
+ExprPtr Parser::ParseIfExpr() {
+    getNextToken(); // consume 'if'
+
+    auto Cond = ParseExpression();
+    if (!Cond)
+        return nullptr;
+
+    auto Then = ParseBracedBlock();
+    if (!Then)
+        return nullptr;
+
+    ExprPtr Else;
+    if (CurTok == tok_else) {
+        getNextToken(); // consume 'else'
+        Else = CurTok == tok_if ? ParseIfExpr() : ParseBracedBlock();
+        if (!Else)
+            return nullptr;
+    }
+
+    return Arena.make<IfExprAST>(std::move(Cond), std::move(Then), std::move(Else));
+}
+
+// Parse 'while cond { ... }'
+ExprPtr Parser::ParseWhileExpr() {
+    getNextToken(); // consume 'while'
+
+    auto Cond = ParseExpression();
+    if (!Cond)
+        return nullptr;
+
+    auto Body = ParseBracedBlock();
+    if (!Body)
+        return nullptr;
+
+    return Arena.make<WhileExprAST>(std::move(Cond), std::move(Body));
 }
 
 // Parse function definitions
-std::unique_ptr<FunctionAST> ParseFunction() {
+std::unique_ptr<FunctionAST> Parser::ParseFunction() {
     if (CurTok != tok_func) {
         std::cerr << "Expected 'func'\n";
         return nullptr;
@@ -189,16 +274,21 @@ std::unique_ptr<FunctionAST> ParseFunction() {
         return nullptr;
     }
 
-    std::string FuncName = IdentifierStr;
+    std::string FuncName(Tok.Text);
     getNextToken(); // consume name
 
+    // 'binary' followed by an operator character defines that operator
+    bool IsOperator = FuncName == "binary" && CurTok != '(';
+    if (IsOperator && !ParseOperatorDecl(FuncName))
+        return nullptr;
+
     if (CurTok != '(') {
         std::cerr << "Expected '('\n";
         return nullptr;
     }
     getNextToken();
 
-    std::vector<std::string> Args;
+    std::vector<SymbolID> Args;
     if (CurTok != ')') {  // Check if there are any arguments
         do {
             if (CurTok != tok_identifier) {
@@ -206,7 +296,7 @@ std::unique_ptr<FunctionAST> ParseFunction() {
                 return nullptr;
             }
 
-            Args.push_back(IdentifierStr);
+            Args.push_back(Arena.intern(Tok.Text));
             getNextToken();
             
             if (CurTok != ',' && CurTok != ')')
@@ -224,6 +314,12 @@ std::unique_ptr<FunctionAST> ParseFunction() {
     }
     getNextToken();
 
+    if (IsOperator && Args.size() != 2) {
+        std::cerr << "Binary operator " << FuncName << " expects 2 arguments, got " << Args.size()
+                  << "\n";
+        return nullptr;
+    }
+
     if (CurTok != '{') {
         std::cerr << "Expected '{'\n";
         return nullptr;
@@ -240,5 +336,60 @@ std::unique_ptr<FunctionAST> ParseFunction() {
     }
     getNextToken();
 
-    return std::make_unique<FunctionAST>(FuncName, std::move(Args), std::move(Body));
-}
\ No newline at end of file
+    return std::make_unique<FunctionAST>(FuncName, std::move(Args), std::move(Body),
+                                         Arena.getSymbols());
+}
+
+// Parse the rest of 'func binary<op> <precedence> [left|right]' after 'binary'.
+// The operator is usable from here on, including in its own body; FuncName
+// becomes the name of the function that implements it.
+bool Parser::ParseOperatorDecl(std::string& FuncName) {
+    int Op = CurTok;
+    if (Op < 0 || Op > 127 || !ispunct(Op) || std::strchr("(){},;=#.", Op)) {
+        std::cerr << "Expected operator character after 'binary'\n";
+        return false;
+    }
+    if (IsBuiltinBinop(static_cast<char>(Op))) {
+        std::cerr << "Cannot redefine builtin operator: " << static_cast<char>(Op) << "\n";
+        return false;
+    }
+    getNextToken(); // consume operator
+
+    if (CurTok != tok_number || Tok.NumVal != static_cast<int>(Tok.NumVal) || Tok.NumVal < 1 ||
+        Tok.NumVal > MaxUserPrecedence) {
+        std::cerr << "Expected operator precedence between 1 and " << MaxUserPrecedence << "\n";
+        return false;
+    }
+    int Prec = static_cast<int>(Tok.NumVal);
+    getNextToken(); // consume precedence
+
+    bool RightAssoc = false;
+    if (CurTok == tok_identifier && (Tok.Text == "left" || Tok.Text == "right")) {
+        RightAssoc = Tok.Text == "right";
+        getNextToken(); // consume associativity
+    }
+
+    Binops.Precedence[Op] = static_cast<int8_t>(Prec);
+    Binops.RightAssoc[Op] = RightAssoc;
+    FuncName = OperatorFunctionName(static_cast<char>(Op));
+    return true;
+}
+
+// Parse every function definition up to end of input
+std::vector<std::unique_ptr<FunctionAST>> Parser::ParseTranslationUnit() {
+    std::vector<std::unique_ptr<FunctionAST>> Functions;
+
+    while (CurTok != tok_eof) {
+        if (auto Func = ParseFunction()) {
+            Functions.push_back(std::move(Func));
+            continue;
+        }
+
+        // Skip to the next 'func' so one bad definition doesn't hide errors in the rest
+        HadError = true;
+        while (CurTok != tok_eof && CurTok != tok_func)
+            getNextToken();
+    }
+
+    return Functions;
+}
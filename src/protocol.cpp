@@ -0,0 +1,95 @@
+#include "protocol.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Largest payload either side accepts, to bound memory per connection
+static constexpr size_t MaxPayload = 256u << 20;
+
+bool MessageStream::fill() {
+    char Chunk[64 * 1024];
+    while (true) {
+        ssize_t N = ::read(FD, Chunk, sizeof(Chunk));
+        if (N > 0) {
+            Buffer.append(Chunk, N);
+            return true;
+        }
+        if (N == 0 || errno != EINTR)
+            return false;
+    }
+}
+
+bool MessageStream::read(std::vector<std::string>& Header, std::string& Payload) {
+    size_t EOL;
+    while ((EOL = Buffer.find('\n')) == std::string::npos)
+        if (!fill())
+            return false;
+
+    std::istringstream Words(Buffer.substr(0, EOL));
+    Buffer.erase(0, EOL + 1);
+    Header.clear();
+    for (std::string Word; Words >> Word;)
+        Header.push_back(std::move(Word));
+    if (Header.empty())
+        return false;
+
+    char* End = nullptr;
+    unsigned long long Length = std::strtoull(Header.back().c_str(), &End, 10);
+    if (*End != '\0' || Length > MaxPayload)
+        return false;
+    Header.pop_back();
+
+    while (Buffer.size() < Length)
+        if (!fill())
+            return false;
+    Payload.assign(Buffer, 0, Length);
+    Buffer.erase(0, Length);
+    return true;
+}
+
+bool MessageStream::write(std::string_view Header, std::string_view Payload) {
+    std::string Message;
+    Message.reserve(Header.size() + Payload.size() + 24);
+    Message.append(Header);
+    Message += " " + std::to_string(Payload.size()) + "\n";
+    Message.append(Payload);
+
+    const char* Data = Message.data();
+    size_t Left = Message.size();
+    while (Left) {
+        ssize_t N = ::send(FD, Data, Left, MSG_NOSIGNAL);
+        if (N < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        Data += N;
+        Left -= N;
+    }
+    return true;
+}
+
+int ConnectUnixSocket(const std::string& Path) {
+    sockaddr_un Addr{};
+    Addr.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Addr.sun_path)) {
+        std::cerr << "Socket path too long: " << Path << "\n";
+        return -1;
+    }
+    std::strcpy(Addr.sun_path, Path.c_str());
+
+    int FD = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (FD < 0 || ::connect(FD, reinterpret_cast<sockaddr*>(&Addr), sizeof(Addr)) < 0) {
+        std::cerr << "Cannot connect to " << Path << ": " << std::strerror(errno) << "\n";
+        if (FD >= 0)
+            ::close(FD);
+        return -1;
+    }
+    return FD;
+}
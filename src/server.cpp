@@ -0,0 +1,379 @@
+#include "server.hpp"
+#include "protocol.hpp"
+#include "session.hpp"
+#include "target.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+// Options of an ir/obj/jit request; the same spelling as the driver's flags
+struct RequestOptions {
+    int OptLevel = -1; // -1 = default: -O0 for ir/obj, -O2 for jit
+    bool FastMath = false;
+    bool Batch = false;
+    VectorLibrary VecLib = VectorLibrary::None;
+    std::string Entry;
+    TargetSelection Target;
+};
+} // namespace
+
+static bool ParseRequestOptions(const std::vector<std::string>& Header, RequestOptions& Opts,
+                                std::string& Error) {
+    for (size_t i = 1; i < Header.size(); ++i) {
+        const std::string& Arg = Header[i];
+        if (Arg.size() == 3 && Arg[0] == '-' && Arg[1] == 'O' && Arg[2] >= '0' && Arg[2] <= '3')
+            Opts.OptLevel = Arg[2] - '0';
+        else if (Arg == "-ffast-math")
+            Opts.FastMath = true;
+        else if (Arg == "--batch")
+            Opts.Batch = true;
+        else if (Arg.rfind("--veclib=", 0) == 0) {
+            if (!ParseVectorLibrary(Arg.substr(9), Opts.VecLib)) {
+                Error = "unknown vector library " + Arg.substr(9);
+                return false;
+            }
+        }
+        else if (Arg == "--entry" && i + 1 < Header.size())
+            Opts.Entry = Header[++i];
+        else if (Arg == "-march=native")
+            Opts.Target.CPU = "native";
+        else if (Arg.rfind("-mcpu=", 0) == 0)
+            Opts.Target.CPU = Arg.substr(6);
+        else if (Arg.rfind("-mattr=", 0) == 0)
+            Opts.Target.Features = Arg.substr(7);
+        else {
+            Error = "unknown option " + Arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse and generate Source into Session. TM, when given, fixes the module's target;
+// with Optimize the module is also run through the pipeline for OptLevel.
+// Returns false with a message in Error.
+static bool BuildSession(CompilerSession& Session, const std::string& Source,
+                         const RequestOptions& Opts, unsigned OptLevel, llvm::TargetMachine* TM,
+                         bool Optimize, std::string& Error) {
+    Session.setSource(Source);
+    if (!Session.parse()) {
+        Error = "error parsing function";
+        return false;
+    }
+    Session.setFastMath(Opts.FastMath);
+    Session.simplify();
+
+    if (TM)
+        Session.setTarget(*TM);
+    if (!Session.codegen(Opts.Batch)) {
+        Error = "error generating code";
+        return false;
+    }
+    if (Optimize)
+        Session.optimize(OptLevel, TM, Opts.VecLib);
+    return true;
+}
+
+CompileServer::Handle::~Handle() {
+    std::lock_guard<std::mutex> Lock(Owner->Lock);
+    Owner->JIT->removeLibrary(Lib);
+}
+
+CompileServer::CompileServer(unsigned Workers)
+    : Workers(Workers ? Workers : std::max(1u, std::thread::hardware_concurrency())) {}
+
+CompileServer::~CompileServer() {
+    if (ListenFD >= 0) {
+        ::close(ListenFD);
+        ::unlink(SocketPath.c_str());
+    }
+}
+
+bool CompileServer::listen(const std::string& Path) {
+    sockaddr_un Addr{};
+    Addr.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Addr.sun_path)) {
+        std::cerr << "Socket path too long: " << Path << "\n";
+        return false;
+    }
+    std::strcpy(Addr.sun_path, Path.c_str());
+
+    // A socket file left behind by a server that did not shut down cleanly
+    ::unlink(Path.c_str());
+
+    ListenFD = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ListenFD < 0 || ::bind(ListenFD, reinterpret_cast<sockaddr*>(&Addr), sizeof(Addr)) < 0 ||
+        ::listen(ListenFD, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << Path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    SocketPath = Path;
+    return true;
+}
+
+void CompileServer::run() {
+    std::vector<std::thread> Pool;
+    for (unsigned i = 0; i < Workers; ++i)
+        Pool.emplace_back([this] { workerLoop(); });
+
+    // accept() fails once stop() shuts the listening socket down
+    while (true) {
+        int FD = ::accept4(ListenFD, nullptr, nullptr, SOCK_CLOEXEC);
+        if (FD < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        std::lock_guard<std::mutex> Lock(ConnMutex);
+        if (Stopping) {
+            ::close(FD);
+            break;
+        }
+        Pending.push_back(FD);
+        ConnReady.notify_one();
+    }
+
+    stop();
+    for (auto& T : Pool)
+        T.join();
+    for (int FD : Pending)
+        ::close(FD);
+    Pending.clear();
+}
+
+void CompileServer::stop() {
+    std::lock_guard<std::mutex> Lock(ConnMutex);
+    if (Stopping)
+        return;
+    Stopping = true;
+    ::shutdown(ListenFD, SHUT_RDWR);
+    for (int FD : Active)
+        ::shutdown(FD, SHUT_RDWR);
+    ConnReady.notify_all();
+}
+
+void CompileServer::workerLoop() {
+    while (true) {
+        int FD;
+        {
+            std::unique_lock<std::mutex> Lock(ConnMutex);
+            ConnReady.wait(Lock, [this] { return Stopping || !Pending.empty(); });
+            if (Stopping)
+                return;
+            FD = Pending.front();
+            Pending.pop_front();
+            Active.insert(FD);
+        }
+
+        serve(FD);
+
+        {
+            std::lock_guard<std::mutex> Lock(ConnMutex);
+            Active.erase(FD);
+        }
+        ::close(FD);
+    }
+}
+
+void CompileServer::serve(int FD) {
+    MessageStream Stream(FD);
+    std::vector<std::string> Header;
+    std::string Payload, Reply;
+
+    while (Stream.read(Header, Payload)) {
+        if (Header[0] == "shutdown") {
+            Stream.write("ok", "");
+            stop();
+            return;
+        }
+
+        Reply.clear();
+        bool Ok = handle(Header, Payload, Reply);
+        if (!Stream.write(Ok ? "ok" : "error", Reply))
+            return;
+    }
+}
+
+bool CompileServer::handle(const std::vector<std::string>& Header, const std::string& Payload,
+                           std::string& Reply) {
+    const std::string& Command = Header[0];
+    if (Command == "call")
+        return call(Header, Reply);
+    if (Command == "release")
+        return release(Header, Reply);
+    if (Command == "jit")
+        return compileJIT(Header, Payload, Reply);
+    if (Command != "ir" && Command != "obj") {
+        Reply = "unknown request " + Command;
+        return false;
+    }
+
+    RequestOptions Opts;
+    if (!ParseRequestOptions(Header, Opts, Reply))
+        return false;
+    unsigned OptLevel = Opts.OptLevel < 0 ? 0 : Opts.OptLevel;
+
+    // Like the driver, unoptimized IR is target independent
+    std::unique_ptr<llvm::TargetMachine> TM;
+    if (Command == "obj" || OptLevel > 0) {
+        TM = CreateTargetMachine(Opts.Target, OptLevel);
+        if (!TM) {
+            Reply = "cannot create target machine";
+            return false;
+        }
+    }
+
+    CompilerSession Session;
+    if (!BuildSession(Session, Payload, Opts, OptLevel, TM.get(), /*Optimize=*/true, Reply))
+        return false;
+
+    if (Command == "ir") {
+        llvm::raw_string_ostream OS(Reply);
+        Session.getModule().print(OS, nullptr);
+        OS.flush();
+        return true;
+    }
+
+    llvm::SmallVector<char, 0> Object;
+    if (!EmitObject(Session.getModule(), *TM, Object)) {
+        Reply = "cannot emit object file";
+        return false;
+    }
+    Reply.assign(Object.begin(), Object.end());
+    return true;
+}
+
+bool CompileServer::compileJIT(const std::vector<std::string>& Header, const std::string& Payload,
+                               std::string& Reply) {
+    RequestOptions Opts;
+    if (!ParseRequestOptions(Header, Opts, Reply))
+        return false;
+    unsigned OptLevel = Opts.OptLevel < 0 ? 2 : Opts.OptLevel;
+
+    // The JIT optimizes the module itself as it is materialized
+    CompilerSession Session;
+    if (!BuildSession(Session, Payload, Opts, OptLevel, nullptr, /*Optimize=*/false, Reply))
+        return false;
+
+    const auto& Functions = Session.getFunctions();
+    if (Functions.empty()) {
+        Reply = "no functions to run";
+        return false;
+    }
+    FunctionAST* Func = Functions.back().get();
+    if (!Opts.Entry.empty()) {
+        auto It = std::find_if(Functions.begin(), Functions.end(),
+                               [&](const auto& F) { return F->getName() == Opts.Entry; });
+        if (It == Functions.end()) {
+            Reply = "no function named " + Opts.Entry;
+            return false;
+        }
+        Func = It->get();
+    }
+    std::string Name = Func->getName();
+    unsigned Arity = Func->getArgs().size();
+
+    uint64_t Id;
+    {
+        std::lock_guard<std::mutex> Lock(HandleMutex);
+        Id = NextHandle++;
+    }
+
+    WarmJIT& Warm = JITs[static_cast<int>(Opts.VecLib)][OptLevel];
+    void* Addr = nullptr;
+    llvm::orc::JITDylib* Lib = nullptr;
+    {
+        std::lock_guard<std::mutex> Lock(Warm.Lock);
+        if (!Warm.JIT)
+            Warm.JIT = MyLangJIT::Create(OptLevel, false, Opts.VecLib);
+        if (Warm.JIT)
+            Lib = Warm.JIT->createLibrary("request" + std::to_string(Id));
+        if (Lib && Warm.JIT->addModule(Session.takeModule(), Lib))
+            Addr = Warm.JIT->lookup(Name, Lib);
+        if (Lib && !Addr)
+            Warm.JIT->removeLibrary(Lib);
+    }
+    if (!Addr) {
+        Reply = "JIT compilation failed";
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(HandleMutex);
+        Handles[Id] = std::shared_ptr<Handle>(new Handle{&Warm, Lib, Addr, Arity});
+    }
+    Reply = std::to_string(Id) + " " + Name + " " + std::to_string(Arity);
+    return true;
+}
+
+bool CompileServer::call(const std::vector<std::string>& Header, std::string& Reply) {
+    if (Header.size() < 2) {
+        Reply = "call needs a handle";
+        return false;
+    }
+
+    std::shared_ptr<Handle> H;
+    {
+        std::lock_guard<std::mutex> Lock(HandleMutex);
+        auto It = Handles.find(std::strtoull(Header[1].c_str(), nullptr, 10));
+        if (It != Handles.end())
+            H = It->second;
+    }
+    if (!H) {
+        Reply = "unknown handle " + Header[1];
+        return false;
+    }
+
+    std::vector<double> Args;
+    for (size_t i = 2; i < Header.size(); ++i) {
+        char* End = nullptr;
+        Args.push_back(std::strtod(Header[i].c_str(), &End));
+        if (*End != '\0') {
+            Reply = "bad argument " + Header[i];
+            return false;
+        }
+    }
+    if (Args.size() != H->Arity) {
+        Reply = "expected " + std::to_string(H->Arity) + " arguments, got " +
+                std::to_string(Args.size());
+        return false;
+    }
+    if (H->Arity > MaxJITCallArgs) {
+        Reply = "cannot call a function with " + std::to_string(H->Arity) + " arguments (max " +
+                std::to_string(MaxJITCallArgs) + ")";
+        return false;
+    }
+
+    std::ostringstream OS;
+    OS << CallJITFunction(H->Addr, Args);
+    Reply = OS.str();
+    return true;
+}
+
+bool CompileServer::release(const std::vector<std::string>& Header, std::string& Reply) {
+    std::shared_ptr<Handle> H;
+    {
+        std::lock_guard<std::mutex> Lock(HandleMutex);
+        auto It = Header.size() == 2 ? Handles.find(std::strtoull(Header[1].c_str(), nullptr, 10))
+                                     : Handles.end();
+        if (It == Handles.end()) {
+            Reply = "unknown handle";
+            return false;
+        }
+        H = std::move(It->second);
+        Handles.erase(It);
+    }
+    // The library is removed here, or by the last call still using it
+    return true;
+}
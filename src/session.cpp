@@ -0,0 +1,213 @@
+#include "session.hpp"
+#include "codegen.hpp"
+#include "lexer.hpp"
+#include "optimizer.hpp"
+#include "parser.hpp"
+#include "parallel.hpp"
+#include "simplify.hpp"
+#include "target.hpp"
+#include <algorithm>
+#include <iostream>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Shards per thread: enough that work stealing can even out functions of
+// very different size, few enough that per-shard contexts stay cheap
+static constexpr size_t ShardsPerThread = 4;
+
+CompilerSession::CompilerSession(bool UseArena)
+    : Arena(UseArena),
+      Context(std::make_unique<llvm::LLVMContext>()),
+      TheModule(std::make_unique<llvm::Module>("MyModule", *Context)) {}
+
+bool CompilerSession::loadFile(const std::string& Path) {
+    PhaseTimer Timer(Stats, "read");
+    SourceBuffer = LoadSourceFile(Path);
+    if (!SourceBuffer)
+        return false;
+    Source = std::string_view(SourceBuffer->getBufferStart(), SourceBuffer->getBufferSize());
+    return true;
+}
+
+bool CompilerSession::parse() {
+    PhaseTimer Timer(Stats, "parse"); // includes lexing, which the parser drives
+    Parser P(Source, Arena, Operators ? *Operators : BuiltinBinops);
+    P.getNextToken();
+    Functions = P.ParseTranslationUnit();
+    if (Operators)
+        *Operators = P.getBinops();
+    if (Stats) {
+        Stats->Tokens = P.getTokenCount();
+        Stats->Functions = Functions.size();
+        Stats->ASTNodes = Arena.getNodeCount();
+        Stats->ASTBytes = Arena.getBytesAllocated();
+    }
+    return !P.hadError();
+}
+
+void CompilerSession::simplify() {
+    PhaseTimer Timer(Stats, "simplify");
+    for (const auto& Func : Functions)
+        SimplifyFunction(Func.get(), &Arena, FastMath);
+    if (Stats) {
+        Stats->ASTNodes = Arena.getNodeCount();
+        Stats->ASTBytes = Arena.getBytesAllocated();
+    }
+}
+
+bool CompilerSession::codegen(bool WithBatchKernel) {
+    PhaseTimer Timer(Stats, "codegen");
+    if (Threads > 1 && Functions.size() > 1)
+        return codegenShards(WithBatchKernel);
+
+    LLVMModuleGenerator Generator(*TheModule, FastMath);
+    for (const auto& Func : Functions) {
+        llvm::Function* F = Generator.generate(Func.get());
+        if (!F || (WithBatchKernel && !GenerateBatchKernel(F)))
+            return false;
+    }
+    if (Stats)
+        Stats->IRInstructions = CountInstructions(*TheModule);
+    return true;
+}
+
+bool CompilerSession::codegenShards(bool WithBatchKernel) {
+    // Every function's arity, so calls into other shards are declared with the right type.
+    // Shards cannot see each other's definitions, so duplicates are caught here.
+    PrototypeMap Prototypes;
+    for (const auto& Func : Functions) {
+        if (!Prototypes.try_emplace(Func->getName(), Func->getArgs().size()).second) {
+            std::cerr << "Function redefined: " << Func->getName() << "\n";
+            return false;
+        }
+    }
+
+    // Callees defined nowhere are declared by each shard from its own first call. The
+    // single module of the serial path rejects calls that disagree with that
+    // declaration, so check every call against the first one in source order here.
+    PrototypeMap Externals;
+    std::vector<CallExprAST*> Calls;
+    for (const auto& Func : Functions) {
+        Calls.clear();
+        CollectCalls(Func->getBody(), Calls);
+        for (CallExprAST* Call : Calls) {
+            std::string_view Name = Func->getSymbols().name(Call->getCallee());
+            llvm::StringRef Callee(Name.data(), Name.size());
+            if (FindMathBuiltin(Name) || Prototypes.count(Callee))
+                continue;
+            auto Declared = Externals.try_emplace(Callee, Call->getArgs().size()).first;
+            if (Declared->second != Call->getArgs().size()) {
+                std::cerr << "Function " << Name << " expects " << Declared->second
+                          << " arguments, got " << Call->getArgs().size() << "\n";
+                return false;
+            }
+        }
+    }
+
+    size_t NumShards = std::min(Functions.size(), Threads * ShardsPerThread);
+    Shards.clear();
+    Shards.resize(NumShards);
+    std::vector<char> Succeeded(NumShards, 0);
+    std::vector<uint64_t> Instructions(NumShards, 0);
+
+    ParallelFor(NumShards, Threads, [&](size_t i, unsigned) {
+        ModuleShard& Shard = Shards[i];
+        Shard.Context = std::make_unique<llvm::LLVMContext>();
+        Shard.M = std::make_unique<llvm::Module>(TheModule->getModuleIdentifier(), *Shard.Context);
+        Shard.M->setTargetTriple(TheModule->getTargetTriple());
+        Shard.M->setDataLayout(TheModule->getDataLayout());
+
+        size_t Begin = Functions.size() * i / NumShards;
+        size_t End = Functions.size() * (i + 1) / NumShards;
+        LLVMModuleGenerator Generator(*Shard.M, FastMath, &Prototypes);
+        for (size_t f = Begin; f < End; ++f) {
+            llvm::Function* F = Generator.generate(Functions[f].get());
+            if (!F || (WithBatchKernel && !GenerateBatchKernel(F)))
+                return;
+        }
+        if (Stats)
+            Instructions[i] = CountInstructions(*Shard.M);
+        Succeeded[i] = 1;
+    });
+
+    if (std::find(Succeeded.begin(), Succeeded.end(), 0) != Succeeded.end()) {
+        Shards.clear();
+        return false;
+    }
+    if (Stats) {
+        Stats->IRInstructions = 0;
+        for (uint64_t Count : Instructions)
+            Stats->IRInstructions += Count;
+    }
+    return true;
+}
+
+void CompilerSession::linkShards() {
+    if (Shards.empty())
+        return;
+
+    // Shards live in other contexts, so they move over as bitcode. Writing it
+    // is independent per shard; reading and linking into TheModule is serial,
+    // in shard order, which keeps functions in source order.
+    std::vector<llvm::SmallVector<char, 0>> Bitcode(Shards.size());
+    ParallelFor(Shards.size(), Threads, [&](size_t i, unsigned) {
+        llvm::raw_svector_ostream OS(Bitcode[i]);
+        llvm::WriteBitcodeToFile(*Shards[i].M, OS);
+        Shards[i].M.reset();
+        Shards[i].Context.reset();
+    });
+    Shards.clear();
+
+    for (const auto& Data : Bitcode) {
+        llvm::MemoryBufferRef Buffer(llvm::StringRef(Data.data(), Data.size()), "shard");
+        auto Shard = llvm::parseBitcodeFile(Buffer, *Context);
+        if (!Shard)
+            llvm::report_fatal_error(llvm::Twine("Cannot read module shard: ") +
+                                     llvm::toString(Shard.takeError()));
+        // Definitions are unique and call types agree (see codegenShards), so this cannot conflict
+        if (llvm::Linker::linkModules(*TheModule, std::move(*Shard)))
+            llvm::report_fatal_error("Cannot link module shard");
+    }
+}
+
+void CompilerSession::setTarget(const llvm::TargetMachine& TM) {
+    TheModule->setTargetTriple(TM.getTargetTriple().str());
+    TheModule->setDataLayout(TM.createDataLayout());
+}
+
+void CompilerSession::optimize(unsigned OptLevel, llvm::TargetMachine* TM, VectorLibrary VecLib) {
+    PhaseTimer Timer(Stats, "optimize");
+    if (Shards.empty()) {
+        OptimizeModule(*TheModule, OptLevel, TM, VecLib);
+        return;
+    }
+
+    // TargetMachines are not thread-safe, so each thread optimizes with its own copy
+    std::vector<std::unique_ptr<llvm::TargetMachine>> ThreadTMs(Threads);
+    ParallelFor(Shards.size(), Threads, [&](size_t i, unsigned Thread) {
+        if (TM && !ThreadTMs[Thread])
+            ThreadTMs[Thread] = CloneTargetMachine(*TM);
+        OptimizeModule(*Shards[i].M, OptLevel, ThreadTMs[Thread].get(), VecLib);
+    });
+}
+
+llvm::orc::ThreadSafeModule CompilerSession::takeModule() {
+    linkShards();
+    return llvm::orc::ThreadSafeModule(std::move(TheModule), std::move(Context));
+}
+
+std::vector<llvm::orc::ThreadSafeModule> CompilerSession::takeModules() {
+    std::vector<llvm::orc::ThreadSafeModule> Modules;
+    if (Shards.empty()) {
+        Modules.push_back(takeModule());
+        return Modules;
+    }
+    for (ModuleShard& Shard : Shards)
+        Modules.emplace_back(std::move(Shard.M), std::move(Shard.Context));
+    Shards.clear();
+    return Modules;
+}
@@ -0,0 +1,226 @@
+#include "simplify.hpp"
+#include <cmath>
+
+static NumberExprAST* AsNumber(ExprAST* E) { return dynamic_cast<NumberExprAST*>(E); }
+
+// Matches the exact constant, including the sign of zero
+static bool IsConstant(ExprAST* E, double Val) {
+    NumberExprAST* N = AsNumber(E);
+    return N && N->getValue() == Val && std::signbit(N->getValue()) == std::signbit(Val);
+}
+
+static bool IsSameVariable(ExprAST* A, ExprAST* B) {
+    auto* VA = dynamic_cast<VariableExprAST*>(A);
+    auto* VB = dynamic_cast<VariableExprAST*>(B);
+    return VA && VB && VA->getName() == VB->getName();
+}
+
+// True if evaluating E has no effect besides its value, so it may be dropped
+static bool IsPure(ExprAST* E) {
+    llvm::SmallVector<ExprAST*, 16> Pending{E};
+    while (!Pending.empty()) {
+        ExprAST* Node = Pending.pop_back_val();
+        if (dynamic_cast<NumberExprAST*>(Node) || dynamic_cast<VariableExprAST*>(Node))
+            continue;
+        // User-defined operators are calls
+        auto* B = dynamic_cast<BinaryExprAST*>(Node);
+        if (!B || !IsBuiltinBinop(B->getOperator()))
+            return false;
+        Pending.push_back(B->getLHS());
+        Pending.push_back(B->getRHS());
+    }
+    return true;
+}
+
+// Evaluate a binary operator on constants the same way the generated code would
+static bool FoldConstants(char Op, double L, double R, double& Result) {
+    switch (Op) {
+        case '+': Result = L + R; return true;
+        case '-': Result = L - R; return true;
+        case '*': Result = L * R; return true;
+        case '/': Result = L / R; return true;
+        case '<': Result = L < R ? 1.0 : 0.0; return true;
+        default: return false;
+    }
+}
+
+ExprPtr ASTSimplifier::makeNumber(double Val) {
+    return Arena ? Arena->make<NumberExprAST>(Val) : MakeAST<NumberExprAST>(Val);
+}
+
+void ASTSimplifier::keepLocals(ExprAST* Dropped) {
+    if (!Function || !Dropped)
+        return;
+    std::vector<SymbolID> Names;
+    CollectAssignedNames(Dropped, Names);
+    for (SymbolID Name : Names)
+        Function->declareLocal(Name);
+}
+
+void ASTSimplifier::simplify(ExprPtr& Slot) {
+    if (!Slot)
+        return;
+
+    Replacement = nullptr;
+    Slot->accept(*this);
+    if (Replacement)
+        Slot = std::move(Replacement);
+}
+
+void ASTSimplifier::visit(NumberExprAST*) {}
+
+void ASTSimplifier::visit(VariableExprAST*) {}
+
+void ASTSimplifier::visit(BinaryExprAST* expr) {
+    // Nested operators are folded bottom-up without recursion; the root's
+    // replacement, if any, is left in Replacement for simplify()
+    WalkBinaryTree(
+        expr,
+        [&](ExprPtr& Operand) {
+            simplify(Operand);
+            return true;
+        },
+        [&](BinaryExprAST* Node, ExprPtr* Slot) {
+            Replacement = nullptr;
+            foldBinary(Node);
+            if (Slot && Replacement)
+                *Slot = std::move(Replacement);
+            return true;
+        });
+}
+
+void ASTSimplifier::foldBinary(BinaryExprAST* expr) {
+    char Op = expr->getOperator();
+    ExprAST* L = expr->getLHS();
+    ExprAST* R = expr->getRHS();
+    NumberExprAST* LNum = AsNumber(L);
+    NumberExprAST* RNum = AsNumber(R);
+
+    // Constant subtree
+    double Folded;
+    if (LNum && RNum && FoldConstants(Op, LNum->getValue(), RNum->getValue(), Folded)) {
+        Replacement = makeNumber(Folded);
+        return;
+    }
+
+    // Identities that hold for every IEEE value, including -0.0, infinities and NaN
+    switch (Op) {
+        case '*':
+            if (IsConstant(R, 1.0)) { Replacement = std::move(expr->getLHSPtr()); return; }
+            if (IsConstant(L, 1.0)) { Replacement = std::move(expr->getRHSPtr()); return; }
+            break;
+        case '/':
+            if (IsConstant(R, 1.0)) { Replacement = std::move(expr->getLHSPtr()); return; }
+            break;
+        case '-':
+            if (IsConstant(R, 0.0)) { Replacement = std::move(expr->getLHSPtr()); return; }
+            break;
+        case '+':
+            if (IsConstant(R, -0.0)) { Replacement = std::move(expr->getLHSPtr()); return; }
+            if (IsConstant(L, -0.0)) { Replacement = std::move(expr->getRHSPtr()); return; }
+            break;
+    }
+
+    if (!FastMath)
+        return;
+
+    // Identities that ignore signed zeros, infinities and NaN
+    switch (Op) {
+        case '+':
+            if (RNum && RNum->getValue() == 0.0) { Replacement = std::move(expr->getLHSPtr()); return; }
+            if (LNum && LNum->getValue() == 0.0) { Replacement = std::move(expr->getRHSPtr()); return; }
+            break;
+        case '-':
+            if (RNum && RNum->getValue() == 0.0) { Replacement = std::move(expr->getLHSPtr()); return; }
+            if (IsSameVariable(L, R)) { Replacement = makeNumber(0.0); return; }
+            break;
+        case '*':
+            if (((RNum && RNum->getValue() == 0.0) || (LNum && LNum->getValue() == 0.0)) &&
+                IsPure(L) && IsPure(R)) {
+                Replacement = makeNumber(0.0);
+                return;
+            }
+            break;
+    }
+
+    // Reassociate constants: (x op c1) op c2 -> x op (c1 op c2) for + and *
+    if ((Op == '+' || Op == '*') && (LNum || RNum)) {
+        double Outer = LNum ? LNum->getValue() : RNum->getValue();
+        ExprPtr& OtherSlot = LNum ? expr->getRHSPtr() : expr->getLHSPtr();
+
+        auto* Inner = dynamic_cast<BinaryExprAST*>(OtherSlot.get());
+        if (!Inner || Inner->getOperator() != Op)
+            return;
+
+        NumberExprAST* InnerNum = AsNumber(Inner->getRHS());
+        ExprPtr* Rest = &Inner->getLHSPtr();
+        if (!InnerNum) {
+            InnerNum = AsNumber(Inner->getLHS());
+            Rest = &Inner->getRHSPtr();
+        }
+        if (!InnerNum)
+            return;
+
+        double Combined;
+        FoldConstants(Op, InnerNum->getValue(), Outer, Combined);
+        ExprPtr X = std::move(*Rest);
+        Replacement = Arena ? Arena->make<BinaryExprAST>(Op, std::move(X), makeNumber(Combined))
+                            : MakeAST<BinaryExprAST>(Op, std::move(X), makeNumber(Combined));
+    }
+}
+
+void ASTSimplifier::visit(ReturnExprAST* expr) {
+    simplify(expr->getExprPtr());
+}
+
+void ASTSimplifier::visit(BlockExprAST* expr) {
+    for (auto& expression : expr->getExpressions())
+        simplify(expression);
+}
+
+void ASTSimplifier::visit(IfExprAST* expr) {
+    simplify(expr->getCondPtr());
+    simplify(expr->getThenPtr());
+    simplify(expr->getElsePtr());
+
+    // A constant condition selects its branch at compile time
+    if (NumberExprAST* Cond = AsNumber(expr->getCond())) {
+        keepLocals(Cond->getValue() != 0.0 ? expr->getElse() : expr->getThen());
+        if (Cond->getValue() != 0.0)
+            Replacement = std::move(expr->getThenPtr());
+        else if (expr->getElse())
+            Replacement = std::move(expr->getElsePtr());
+        else
+            Replacement = makeNumber(0.0);
+    }
+}
+
+void ASTSimplifier::visit(WhileExprAST* expr) {
+    simplify(expr->getCondPtr());
+    simplify(expr->getBodyPtr());
+
+    if (IsConstant(expr->getCond(), 0.0) || IsConstant(expr->getCond(), -0.0)) {
+        keepLocals(expr->getBody());
+        Replacement = makeNumber(0.0);
+    }
+}
+
+void ASTSimplifier::visit(AssignExprAST* expr) {
+    simplify(expr->getValuePtr());
+}
+
+void ASTSimplifier::visit(CallExprAST* expr) {
+    for (auto& Arg : expr->getArgs())
+        simplify(Arg);
+}
+
+void ASTSimplifier::visit(FunctionAST* func) {
+    Function = func;
+    simplify(func->getBodyPtr());
+    Function = nullptr;
+}
+
+void SimplifyFunction(FunctionAST* func, ASTArena* Arena, bool FastMath) {
+    ASTSimplifier Simplifier(Arena, FastMath);
+    func->accept(Simplifier);
+}
@@ -0,0 +1,98 @@
+#include "stats.hpp"
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+
+#include <sys/resource.h>
+
+void CompileStats::merge(const CompileStats& Other) {
+    for (const auto& Phase : Other.Phases)
+        Phases[Phase.getKey()] += Phase.getValue();
+    Tokens += Other.Tokens;
+    ASTNodes += Other.ASTNodes;
+    ASTBytes += Other.ASTBytes;
+    Functions += Other.Functions;
+    IRInstructions += Other.IRInstructions;
+}
+
+uint64_t CountInstructions(const llvm::Module& M) {
+    uint64_t Count = 0;
+    for (const llvm::Function& F : M)
+        Count += F.getInstructionCount();
+    return Count;
+}
+
+uint64_t GetPeakRSS() {
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<uint64_t>(Usage.ru_maxrss); // bytes
+#else
+    return static_cast<uint64_t>(Usage.ru_maxrss) * 1024; // KiB
+#endif
+}
+
+void PrintTimeReport(const CompileStats& Stats, llvm::raw_ostream& OS) {
+    llvm::TimerGroup Group("my_lang", "Compile phase timing report", Stats.Phases);
+    Group.print(OS);
+}
+
+void PrintStats(const CompileStats& Stats, llvm::raw_ostream& OS) {
+    OS << "===" << std::string(73, '-') << "===\n"
+       << "                          Compile statistics\n"
+       << "===" << std::string(73, '-') << "===\n";
+    auto Line = [&](uint64_t Value, const char* Name) {
+        OS << llvm::format("%12llu", static_cast<unsigned long long>(Value)) << "  " << Name << "\n";
+    };
+    Line(Stats.Tokens, "tokens");
+    Line(Stats.ASTNodes, "AST nodes");
+    Line(Stats.ASTBytes, "AST bytes allocated");
+    Line(Stats.Functions, "functions");
+    Line(Stats.IRInstructions, "IR instructions generated");
+    Line(GetPeakRSS(), "peak RSS bytes");
+}
+
+void PrintStatsJSON(const CompileStats& Stats, bool WithTimes, bool WithCounters,
+                    llvm::raw_ostream& OS) {
+    llvm::json::OStream J(OS, 2);
+    J.object([&] {
+        if (WithTimes) {
+            J.attributeObject("time", [&] {
+                llvm::TimeRecord Total;
+                auto Record = [&](llvm::StringRef Name, const llvm::TimeRecord& T) {
+                    J.attributeObject(Name, [&] {
+                        J.attribute("wall", T.getWallTime());
+                        J.attribute("user", T.getUserTime());
+                        J.attribute("sys", T.getSystemTime());
+                    });
+                };
+                // StringMap order is unspecified; sort so reports diff cleanly
+                std::vector<llvm::StringRef> Names;
+                for (const auto& Phase : Stats.Phases)
+                    Names.push_back(Phase.getKey());
+                llvm::sort(Names);
+                for (llvm::StringRef Name : Names) {
+                    const llvm::TimeRecord& T = Stats.Phases.find(Name)->getValue();
+                    Record(Name, T);
+                    Total += T;
+                }
+                Record("total", Total);
+            });
+        }
+        if (WithCounters) {
+            J.attributeObject("stats", [&] {
+                J.attribute("tokens", static_cast<int64_t>(Stats.Tokens));
+                J.attribute("ast_nodes", static_cast<int64_t>(Stats.ASTNodes));
+                J.attribute("ast_bytes", static_cast<int64_t>(Stats.ASTBytes));
+                J.attribute("functions", static_cast<int64_t>(Stats.Functions));
+                J.attribute("ir_instructions", static_cast<int64_t>(Stats.IRInstructions));
+                J.attribute("peak_rss_bytes", static_cast<int64_t>(GetPeakRSS()));
+            });
+        }
+    });
+    OS << "\n";
+}
@@ -0,0 +1,110 @@
+#include "stream.hpp"
+#include "lexer.hpp"
+#include "parallel.hpp"
+#include "parser.hpp"
+#include "session.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Input is read in pieces of this size
+static constexpr size_t ReadChunkSize = 1 << 16;
+
+namespace {
+// One definition on its way from the parse stage to the codegen stage.
+// Heap-allocated so the session's view of Text stays valid as it is queued.
+struct StreamUnit {
+    std::string Text;
+    std::unique_ptr<CompileStats> Stats;
+    std::unique_ptr<CompilerSession> Session;
+    bool Parsed = false;
+};
+} // namespace
+
+bool CompileStream(const std::string& Path, const StreamOptions& Opts, llvm::raw_ostream& OS) {
+    std::FILE* In = Path == "-" ? stdin : std::fopen(Path.c_str(), "rb");
+    if (!In) {
+        std::cerr << "Cannot read " << Path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    BoundedQueue<std::string> Definitions(Opts.QueueDepth);
+    BoundedQueue<std::unique_ptr<StreamUnit>> Parsed(Opts.QueueDepth);
+    bool ReadOk = true;
+
+    // Stage 1: read the input in chunks and cut it into definitions
+    std::thread Reader([&] {
+        DefinitionSplitter Splitter;
+        auto Emit = [&](std::string Text) { Definitions.push(std::move(Text)); };
+        std::vector<char> Buffer(ReadChunkSize);
+        size_t N;
+        while ((N = std::fread(Buffer.data(), 1, Buffer.size(), In)) > 0)
+            Splitter.feed(std::string_view(Buffer.data(), N), Emit);
+        if (std::ferror(In)) {
+            std::cerr << "Cannot read " << Path << "\n";
+            ReadOk = false;
+        }
+        Splitter.finish(Emit);
+        Definitions.close();
+    });
+
+    // Stage 2: parse and simplify each definition in its own session, with the
+    // operators declared by the definitions before it
+    std::thread ParseStage([&] {
+        BinopTable Operators = BuiltinBinops;
+        std::string Text;
+        while (Definitions.pop(Text)) {
+            auto Unit = std::make_unique<StreamUnit>();
+            Unit->Text = std::move(Text);
+            Unit->Session = std::make_unique<CompilerSession>();
+            if (Opts.Stats) {
+                Unit->Stats = std::make_unique<CompileStats>();
+                Unit->Session->setStats(Unit->Stats.get());
+            }
+            Unit->Session->setSource(Unit->Text);
+            Unit->Session->setOperators(&Operators);
+            Unit->Parsed = Unit->Session->parse();
+            if (Unit->Parsed) {
+                Unit->Session->setFastMath(Opts.FastMath);
+                Unit->Session->simplify();
+            }
+            Parsed.push(std::move(Unit));
+        }
+        Parsed.close();
+    });
+
+    // Stage 3, on this thread: generate, optimize and print, then free the definition
+    bool Ok = true;
+    std::unique_ptr<StreamUnit> Unit;
+    while (Parsed.pop(Unit)) {
+        CompilerSession& Session = *Unit->Session;
+        if (!Unit->Parsed) {
+            std::cerr << Path << ": Error parsing function.\n";
+            Ok = false;
+        } else {
+            if (Opts.TM)
+                Session.setTarget(*Opts.TM);
+            if (Session.codegen(Opts.WithBatchKernel)) {
+                Session.optimize(Opts.OptLevel, Opts.TM, Opts.VecLib);
+                PhaseTimer Timer(Unit->Stats.get(), "print");
+                Session.getModule().print(OS, nullptr);
+            } else {
+                std::cerr << Path << ": Error generating code.\n";
+                Ok = false;
+            }
+        }
+        if (Opts.Stats)
+            Opts.Stats->merge(*Unit->Stats);
+        Unit.reset();
+    }
+
+    Reader.join();
+    ParseStage.join();
+    if (In != stdin)
+        std::fclose(In);
+    return Ok && ReadOk;
+}
@@ -0,0 +1,51 @@
+#include "symbols.hpp"
+#include <cstring>
+
+// FNV-1a: a byte at a time, which suits short identifiers
+static uint32_t HashName(std::string_view Name) {
+    uint32_t Hash = 2166136261u;
+    for (char C : Name) {
+        Hash ^= static_cast<unsigned char>(C);
+        Hash *= 16777619u;
+    }
+    return Hash;
+}
+
+SymbolID SymbolTable::intern(std::string_view Name) {
+    uint32_t Hash = HashName(Name);
+    size_t Mask = Slots.size() - 1;
+    for (size_t Slot = Hash & Mask;; Slot = (Slot + 1) & Mask) {
+        SymbolID ID = Slots[Slot];
+        if (ID == EmptySlot) {
+            ID = static_cast<SymbolID>(Names.size());
+            char* Copy = Storage.Allocate<char>(Name.size());
+            if (!Name.empty())
+                std::memcpy(Copy, Name.data(), Name.size());
+            Names.emplace_back(Copy, Name.size());
+            Hashes.push_back(Hash);
+            Slots[Slot] = ID;
+            if (Names.size() * 2 > Slots.size())
+                grow();
+            return ID;
+        }
+        if (Hashes[ID] == Hash && Names[ID] == Name)
+            return ID;
+    }
+}
+
+void SymbolTable::grow() {
+    std::vector<SymbolID> Bigger(Slots.size() * 2, EmptySlot);
+    size_t Mask = Bigger.size() - 1;
+    for (SymbolID ID = 0; ID < Names.size(); ++ID) {
+        size_t Slot = Hashes[ID] & Mask;
+        while (Bigger[Slot] != EmptySlot)
+            Slot = (Slot + 1) & Mask;
+        Bigger[Slot] = ID;
+    }
+    Slots = std::move(Bigger);
+}
+
+size_t SymbolTable::getBytesAllocated() const {
+    return Storage.getBytesAllocated() + Names.capacity() * sizeof(std::string_view) +
+           Hashes.capacity() * sizeof(uint32_t) + Slots.capacity() * sizeof(SymbolID);
+}
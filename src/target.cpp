@@ -0,0 +1,143 @@
+#include "target.hpp"
+#include <iostream>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if LLVM_VERSION_MAJOR >= 14
+#include "llvm/MC/TargetRegistry.h"
+#else
+#include "llvm/Support/TargetRegistry.h"
+#endif
+
+#if LLVM_VERSION_MAJOR >= 18
+static constexpr auto ObjectFileType = llvm::CodeGenFileType::ObjectFile;
+#else
+static constexpr auto ObjectFileType = llvm::CGFT_ObjectFile;
+#endif
+
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(const TargetSelection& Target,
+                                                         unsigned OptLevel) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string Triple = llvm::sys::getDefaultTargetTriple();
+    std::string Error;
+    const llvm::Target* T = llvm::TargetRegistry::lookupTarget(Triple, Error);
+    if (!T) {
+        std::cerr << "Cannot find target " << Triple << ": " << Error << "\n";
+        return nullptr;
+    }
+
+    std::string CPU = Target.CPU;
+    std::string Features;
+    if (CPU == "native") {
+        CPU = llvm::sys::getHostCPUName().str();
+        llvm::StringMap<bool> HostFeatures;
+        if (llvm::sys::getHostCPUFeatures(HostFeatures))
+            for (auto& Feature : HostFeatures)
+                Features += (Feature.second ? ",+" : ",-") + Feature.first().str();
+    }
+    if (!Target.Features.empty())
+        Features += "," + Target.Features;
+    if (!Features.empty())
+        Features.erase(0, 1); // leading comma
+
+    llvm::CodeGenOpt::Level Level = OptLevel == 0   ? llvm::CodeGenOpt::None
+                                    : OptLevel == 1 ? llvm::CodeGenOpt::Less
+                                    : OptLevel == 2 ? llvm::CodeGenOpt::Default
+                                                    : llvm::CodeGenOpt::Aggressive;
+
+    llvm::TargetOptions Options;
+    std::unique_ptr<llvm::TargetMachine> TM(T->createTargetMachine(
+        Triple, CPU, Features, Options, llvm::Reloc::PIC_, llvm::None, Level));
+    if (!TM)
+        std::cerr << "Cannot create target machine for " << Triple << " (" << CPU << ")\n";
+    return TM;
+}
+
+std::unique_ptr<llvm::TargetMachine> CloneTargetMachine(const llvm::TargetMachine& TM) {
+    return std::unique_ptr<llvm::TargetMachine>(TM.getTarget().createTargetMachine(
+        TM.getTargetTriple().str(), TM.getTargetCPU(), TM.getTargetFeatureString(), TM.Options,
+        TM.getRelocationModel(), TM.getCodeModel(), TM.getOptLevel()));
+}
+
+bool EmitObject(llvm::Module& Module, llvm::TargetMachine& TM, llvm::SmallVectorImpl<char>& Object) {
+    llvm::raw_svector_ostream OS(Object);
+    llvm::legacy::PassManager PM;
+    if (TM.addPassesToEmitFile(PM, OS, nullptr, ObjectFileType)) {
+        std::cerr << "Target cannot emit object files\n";
+        return false;
+    }
+    PM.run(Module);
+    return true;
+}
+
+bool EmitObjectFile(llvm::Module& Module, llvm::TargetMachine& TM, const std::string& Path) {
+    llvm::SmallVector<char, 0> Object;
+    if (!EmitObject(Module, TM, Object))
+        return false;
+    return WriteObjectFile(llvm::StringRef(Object.data(), Object.size()), Path);
+}
+
+bool WriteObjectFile(llvm::StringRef Object, const std::string& Path) {
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        std::cerr << "Cannot open " << Path << ": " << EC.message() << "\n";
+        return false;
+    }
+    OS << Object;
+    OS.close();
+    if (OS.has_error()) {
+        OS.clear_error();
+        std::cerr << "Cannot write " << Path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool EmitSharedLibrary(llvm::Module& Module, llvm::TargetMachine& TM, const std::string& Path,
+                       llvm::StringRef ExtraLib) {
+    llvm::SmallVector<char, 0> Object;
+    if (!EmitObject(Module, TM, Object))
+        return false;
+    return LinkSharedLibrary(llvm::StringRef(Object.data(), Object.size()), Path, ExtraLib);
+}
+
+bool LinkSharedLibrary(llvm::StringRef Object, const std::string& Path, llvm::StringRef ExtraLib) {
+    llvm::SmallString<128> ObjectPath;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile("my_lang", "o", ObjectPath)) {
+        std::cerr << "Cannot create temporary file: " << EC.message() << "\n";
+        return false;
+    }
+    llvm::FileRemover RemoveObject(ObjectPath);
+
+    if (!WriteObjectFile(Object, ObjectPath.str().str()))
+        return false;
+
+    // LLVM has no in-process linker here, so hand the object to the system compiler driver
+    auto Linker = llvm::sys::findProgramByName("cc");
+    if (!Linker) {
+        std::cerr << "Cannot find 'cc' to link " << Path << "\n";
+        return false;
+    }
+
+    std::string ExtraLibArg = ("-l" + ExtraLib).str();
+    std::vector<llvm::StringRef> Args = {*Linker, "-shared", "-o", Path, ObjectPath, "-lm"};
+    if (!ExtraLib.empty())
+        Args.push_back(ExtraLibArg);
+    std::string ErrMsg;
+    if (llvm::sys::ExecuteAndWait(*Linker, Args, llvm::None, {}, 0, 0, &ErrMsg) != 0) {
+        std::cerr << "Linking " << Path << " failed" << (ErrMsg.empty() ? "" : ": " + ErrMsg) << "\n";
+        return false;
+    }
+    return true;
+}
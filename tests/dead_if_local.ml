@@ -0,0 +1,5 @@
+# y is assigned only in a branch the simplifier removes; it still reads as 0
+func f(x) {
+    if 0 { y = 1; }
+    return y + x;
+}
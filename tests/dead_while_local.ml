@@ -0,0 +1,5 @@
+# y is assigned only in a loop the simplifier removes; it still reads as 0
+func f(x) {
+    while 0 { y = 1; }
+    return y + x;
+}
@@ -0,0 +1,9 @@
+# ext is defined nowhere, so its first call fixes its arity; the second call
+# must be rejected whether or not a and b end up in the same module
+func a(x) {
+    return ext(x);
+}
+
+func b(x, y) {
+    return ext(x, y);
+}
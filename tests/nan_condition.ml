@@ -0,0 +1,7 @@
+# NaN is non-zero, so it is true both when the simplifier folds the
+# condition and when codegen compares it at run time
+func f(x) {
+    a = if 0 / 0 { 1 } else { 2 };
+    b = if x { 10 } else { 20 };
+    return a + b;
+}